@@ -0,0 +1,374 @@
+#include "AdaptiveMarchingSquares.h"
+#include "MarchingSquares.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+//-----------------------------------------------------------------------------
+AdaptiveMarchingSquares::AdaptiveMarchingSquares()
+	:cellsX_(0)
+	,cellsY_(0)
+	,threshold_(0.0f)
+	,tolerance_(0.0f)
+	,visitedNodes_(0)
+	,coarseCells_(0)
+{
+}
+
+
+//
+AdaptiveMarchingSquares::~AdaptiveMarchingSquares()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void AdaptiveMarchingSquares::setGridView(const GridView& view, const int maxLevel)
+{
+	nodeStorage_.resize(layoutLevels(view, maxLevel));
+	buildPyramid();
+}
+
+
+// index file layout of the pyramid
+static const uint32_t PYRAMID_INDEX_KIND = 2;
+static const uint32_t SECTION_PYRAMID_NODES = 1;
+
+
+//
+bool AdaptiveMarchingSquares::setGridView(const GridView& view, const int maxLevel, const std::string& indexFile)
+{
+	const size_t nodeCount = layoutLevels(view, maxLevel);
+	const uint64_t hash = IndexFile::contentHash(view);
+	const uint64_t parameters = levels_.size() - 1;
+
+	if (indexFile_.open(indexFile, PYRAMID_INDEX_KIND, hash, parameters))
+	{
+		uint64_t size;
+		const Node* nodes = static_cast<const Node*>(indexFile_.section(SECTION_PYRAMID_NODES, size));
+
+		if (nodes != NULL && size == nodeCount*sizeof(Node))
+		{
+			nodeStorage_.clear();
+
+			for (size_t l = 0; l < levels_.size(); ++l)
+			{
+				levels_[l].nodes = nodes;
+				nodes += static_cast<size_t>(levels_[l].nodesX)*levels_[l].nodesY;
+			}
+
+			return true;
+		}
+
+		indexFile_.close();
+	}
+
+	nodeStorage_.resize(nodeCount);
+	buildPyramid();
+
+	std::vector<IndexFile::Section> sections;
+	sections.push_back(IndexFile::Section(SECTION_PYRAMID_NODES, nodeStorage_.empty() ? NULL : &nodeStorage_[0],
+										  nodeStorage_.size()*sizeof(Node)));
+	IndexFile::write(indexFile, PYRAMID_INDEX_KIND, hash, parameters, sections);
+
+	return false;
+}
+
+
+//
+size_t AdaptiveMarchingSquares::layoutLevels(const GridView& view, const int maxLevel)
+{
+	grid_ = view;
+	cellsX_ = std::max(view.width - 1, 0);
+	cellsY_ = std::max(view.height - 1, 0);
+
+	indexFile_.close();
+	levels_.assign(std::max(maxLevel, 0) + 1, Level());
+
+	size_t nodeCount = 0;
+
+	for (size_t l = 0; l < levels_.size(); ++l)
+	{
+		Level& level = levels_[l];
+		level.size = 1 << l;
+		level.nodesX = (cellsX_ + level.size - 1) >> l;
+		level.nodesY = (cellsY_ + level.size - 1) >> l;
+		level.nodes = NULL;
+		nodeCount += static_cast<size_t>(level.nodesX)*level.nodesY;
+	}
+
+	return nodeCount;
+}
+
+
+//
+void AdaptiveMarchingSquares::buildPyramid()
+{
+	Node* nodes = nodeStorage_.empty() ? NULL : &nodeStorage_[0];
+
+	for (size_t l = 0; l < levels_.size(); ++l)
+	{
+		Level& level = levels_[l];
+		Node* levelNodes = nodes;
+		level.nodes = levelNodes;
+		nodes += static_cast<size_t>(level.nodesX)*level.nodesY;
+
+		for (int ny = 0; ny < level.nodesY; ++ny)
+		{
+			for (int nx = 0; nx < level.nodesX; ++nx)
+			{
+				Node& node = levelNodes[static_cast<size_t>(ny)*level.nodesX + nx];
+
+				if (l == 0)
+				{
+					const float* row0 = grid_.row(ny);
+					const float* row1 = grid_.row(ny + 1);
+					node.minValue = std::min(std::min(row0[nx], row0[nx+1]), std::min(row1[nx], row1[nx+1]));
+					node.maxValue = std::max(std::max(row0[nx], row0[nx+1]), std::max(row1[nx], row1[nx+1]));
+					node.error = 0.0f;
+					continue;
+				}
+
+				// min/max from the children
+				const Level& child = levels_[l - 1];
+				node.minValue = std::numeric_limits<float>::max();
+				node.maxValue = -std::numeric_limits<float>::max();
+
+				for (int cy = 2*ny; cy < std::min(2*ny + 2, child.nodesY); ++cy)
+				{
+					for (int cx = 2*nx; cx < std::min(2*nx + 2, child.nodesX); ++cx)
+					{
+						const Node& c = child.nodes[static_cast<size_t>(cy)*child.nodesX + cx];
+						node.minValue = std::min(node.minValue, c.minValue);
+						node.maxValue = std::max(node.maxValue, c.maxValue);
+					}
+				}
+
+				// bilinear error over the block's samples
+				const int x0 = nx*level.size;
+				const int y0 = ny*level.size;
+
+				if (x0 + level.size > cellsX_ || y0 + level.size > cellsY_)
+				{
+					node.error = std::numeric_limits<float>::infinity();
+					continue;
+				}
+
+				const float a = grid_.at(x0, y0);
+				const float b = grid_.at(x0 + level.size, y0);
+				const float c = grid_.at(x0 + level.size, y0 + level.size);
+				const float d = grid_.at(x0, y0 + level.size);
+				const float inv = 1.0f/level.size;
+				float error = 0.0f;
+
+				for (int y = 0; y <= level.size; ++y)
+				{
+					const float v = y*inv;
+					const float left = a + (d - a)*v;
+					const float right = b + (c - b)*v;
+					const float* row = grid_.row(y0 + y) + x0;
+
+					for (int x = 0; x <= level.size; ++x)
+						error = std::max(error, fabsf(row[x] - (left + (right - left)*(x*inv))));
+				}
+
+				node.error = error;
+			}
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+void AdaptiveMarchingSquares::computeIsolines(const float threshold, const float tolerance)
+{
+	threshold_ = threshold;
+	tolerance_ = tolerance;
+	visitedNodes_ = 0;
+	coarseCells_ = 0;
+
+	isolineVertexList_.clear();
+
+	if (levels_.empty())
+		return;
+
+	const int top = static_cast<int>(levels_.size()) - 1;
+
+	leaves_.clear();
+
+	for (int y = 0; y < levels_[top].nodesY; ++y)
+		for (int x = 0; x < levels_[top].nodesX; ++x)
+			refine(top, x, y);
+
+	// every leaf corner, so coarse leaves find the finer ones along their edges
+	corners_.clear();
+
+	for (size_t k = 0; k < leaves_.size(); ++k)
+	{
+		const Leaf& leaf = leaves_[k];
+		corners_.push_back(sampleKey(leaf.x0, leaf.y0));
+		corners_.push_back(sampleKey(leaf.x0 + leaf.size, leaf.y0));
+		corners_.push_back(sampleKey(leaf.x0 + leaf.size, leaf.y0 + leaf.size));
+		corners_.push_back(sampleKey(leaf.x0, leaf.y0 + leaf.size));
+	}
+
+	std::sort(corners_.begin(), corners_.end());
+	corners_.erase(std::unique(corners_.begin(), corners_.end()), corners_.end());
+
+	for (size_t k = 0; k < leaves_.size(); ++k)
+		emitLeaf(leaves_[k]);
+}
+
+
+//
+void AdaptiveMarchingSquares::refine(const int level, const int x, const int y)
+{
+	const Level& current = levels_[level];
+	const Node& node = current.nodes[static_cast<size_t>(y)*current.nodesX + x];
+
+	++visitedNodes_;
+
+	// same test as MarchingSquares::classifyCell: some corner above, some not
+	if (!(node.maxValue > threshold_ && node.minValue <= threshold_))
+		return;
+
+	if (level == 0 || node.error <= tolerance_)
+	{
+		Leaf leaf;
+		leaf.x0 = x*current.size;
+		leaf.y0 = y*current.size;
+		leaf.size = current.size;
+		leaves_.push_back(leaf);
+		return;
+	}
+
+	const Level& child = levels_[level - 1];
+
+	for (int cy = 2*y; cy < std::min(2*y + 2, child.nodesY); ++cy)
+		for (int cx = 2*x; cx < std::min(2*x + 2, child.nodesX); ++cx)
+			refine(level - 1, cx, cy);
+}
+
+
+//
+void AdaptiveMarchingSquares::emitCell(const int x0, const int y0, const int size)
+{
+	const float a = grid_.at(x0, y0);
+	const float b = grid_.at(x0 + size, y0);
+	const float c = grid_.at(x0 + size, y0 + size);
+	const float d = grid_.at(x0, y0 + size);
+
+	float segments[8];
+	const int count = MarchingSquares::cellSegments(MarchingSquares::classifyCell(a, b, c, d, threshold_),
+													static_cast<float>(grid_.originX + x0),
+													static_cast<float>(grid_.originY + y0),
+													static_cast<float>(size), static_cast<float>(size),
+													a, b, c, d, threshold_, segments);
+
+	for (int k = 0; k < 2*count; ++k)
+		isolineVertexList_.push_back(Vec2<float>(segments[2*k], segments[2*k+1]));
+
+	if (size > 1)
+		++coarseCells_;
+}
+
+
+//
+void AdaptiveMarchingSquares::addBoundarySample(const int x, const int y, const bool corner)
+{
+	if (corner || std::binary_search(corners_.begin(), corners_.end(), sampleKey(x, y)))
+	{
+		boundary_.push_back(x);
+		boundary_.push_back(y);
+	}
+}
+
+
+//
+void AdaptiveMarchingSquares::emitLeaf(const Leaf& leaf)
+{
+	const int x0 = leaf.x0;
+	const int y0 = leaf.y0;
+	const int size = leaf.size;
+
+	// corners and the finer neighbours' corners on the edges, clockwise from (x0, y0)
+	boundary_.clear();
+
+	for (int k = 0; k < size; ++k)
+		addBoundarySample(x0 + k, y0, k == 0);
+	for (int k = 0; k < size; ++k)
+		addBoundarySample(x0 + size, y0 + k, k == 0);
+	for (int k = 0; k < size; ++k)
+		addBoundarySample(x0 + size - k, y0 + size, k == 0);
+	for (int k = 0; k < size; ++k)
+		addBoundarySample(x0, y0 + size - k, k == 0);
+
+	const int n = static_cast<int>(boundary_.size())/2;
+
+	if (n == 4)
+	{
+		emitCell(x0, y0, size);
+		return;
+	}
+
+	// crossings in boundary order; each edge is interpolated from its lower
+	// sample with the expressions of MarchingSquares::cellSegments, so a
+	// finer neighbour computes the same point
+	crossings_.clear();
+	int entering = -1;
+
+	for (int i = 0; i < n; ++i)
+	{
+		const int j = (i + 1 < n) ? i + 1 : 0;
+		const int px = boundary_[2*i];
+		const int py = boundary_[2*i+1];
+		const int qx = boundary_[2*j];
+		const int qy = boundary_[2*j+1];
+		const float p = grid_.at(px, py);
+		const float q = grid_.at(qx, qy);
+
+		if ((p > threshold_) == (q > threshold_))
+			continue;
+
+		const bool forward = px < qx || py < qy;
+		const int lx = forward ? px : qx;
+		const int ly = forward ? py : qy;
+		const float lower = forward ? p : q;
+		const float upper = forward ? q : p;
+		const float ox = static_cast<float>(grid_.originX + lx);
+		const float oy = static_cast<float>(grid_.originY + ly);
+
+		if (entering < 0 && !(p > threshold_))
+			entering = static_cast<int>(crossings_.size())/2;
+
+		if (py == qy)
+		{
+			const float dx = static_cast<float>(std::abs(qx - px));
+			crossings_.push_back(ox+dx*(threshold_-lower)/(upper-lower));
+			crossings_.push_back(oy);
+		}
+		else
+		{
+			const float dy = static_cast<float>(std::abs(qy - py));
+			crossings_.push_back(ox);
+			crossings_.push_back(oy+dy*(threshold_-lower)/(upper-lower));
+		}
+	}
+
+	// crossings alternate into and out of the regions above; join each
+	// entry to the next exit, cutting off one run of samples above
+	const int count = static_cast<int>(crossings_.size())/2;
+
+	for (int k = 0; k < count; k += 2)
+	{
+		const int in = (entering + k) % count;
+		const int out = (entering + k + 1) % count;
+
+		isolineVertexList_.push_back(Vec2<float>(crossings_[2*in], crossings_[2*in+1]));
+		isolineVertexList_.push_back(Vec2<float>(crossings_[2*out], crossings_[2*out+1]));
+	}
+
+	++coarseCells_;
+}
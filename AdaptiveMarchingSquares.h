@@ -0,0 +1,103 @@
+#pragma once
+#ifndef ADAPTIVEMARCHINGSQUARES_H_INCLUDED
+#define ADAPTIVEMARCHINGSQUARES_H_INCLUDED
+
+#include "Vec2.h"
+#include "GridView.h"
+#include "IndexFile.h"
+#include <list>
+#include <string>
+#include <vector>
+
+// Quadtree marching squares for smooth terrain.
+//
+// setGridView() builds a min/max/error pyramid over square blocks of
+// 2^level cells; the error of a block is the largest distance between its
+// samples and the bilinear patch through its four corners. Extraction
+// descends only into blocks that straddle the threshold and emits a single
+// coarse cell wherever that error is within the tolerance, so smooth areas
+// are contoured without visiting their cells. A negative tolerance refines
+// down to single cells and reproduces MarchingSquares::computeIsolines().
+//
+// Shared edges are stitched: where a coarse cell borders finer ones, the
+// corners of those neighbours on its edges become extra boundary samples of
+// the coarse cell, so both sides cross the shared edge between the same two
+// samples with the same expression and the lines stay closed at the
+// T-junctions. Such a cell is contoured as a polygon, cutting off each run
+// of boundary samples above the threshold (above regions stay separated at
+// saddles, as in MarchingSquares).
+
+class AdaptiveMarchingSquares
+{
+public:
+
+	AdaptiveMarchingSquares();
+	~AdaptiveMarchingSquares();
+
+	// maxLevel: largest block is 2^maxLevel cells wide
+	void setGridView(const GridView& view, const int maxLevel = 8);
+
+	// same, with the pyramid persisted in indexFile: memory-mapped when the
+	// file was built from the same samples and maxLevel, rebuilt and
+	// overwritten otherwise. Returns true when the pyramid was loaded.
+	bool setGridView(const GridView& view, const int maxLevel, const std::string& indexFile);
+
+	// tolerance is in height units
+	void computeIsolines(const float threshold, const float tolerance);
+
+	inline std::list< Vec2<float> >* getIsolineVertexList() { return &isolineVertexList_; };
+	inline const long long getVisitedNodes() const { return visitedNodes_; };
+	inline const long long getCoarseCells() const { return coarseCells_; };
+
+protected:
+
+	struct Node
+	{
+		float minValue;
+		float maxValue;
+		float error;	// bilinear error, infinite for blocks clipped by the border
+	};
+
+	struct Leaf
+	{
+		int x0;
+		int y0;
+		int size;
+	};
+
+	struct Level
+	{
+		int size;		// cells per block side
+		int nodesX;
+		int nodesY;
+		const Node* nodes;	// into nodeStorage_ or indexFile_
+	};
+
+	size_t layoutLevels(const GridView& view, const int maxLevel);
+	void buildPyramid();
+	void refine(const int level, const int x, const int y);
+	void emitCell(const int x0, const int y0, const int size);
+	void emitLeaf(const Leaf& leaf);
+	void addBoundarySample(const int x, const int y, const bool corner);
+	inline long long sampleKey(const int x, const int y) const { return static_cast<long long>(y)*(cellsX_ + 1) + x; };
+
+	GridView grid_;
+	int cellsX_;
+	int cellsY_;
+	float threshold_;
+	float tolerance_;
+	std::vector<Level> levels_;
+	std::vector<Node> nodeStorage_;		// all levels, finest first
+	IndexFile indexFile_;
+	long long visitedNodes_;
+	long long coarseCells_;
+	std::vector<Leaf> leaves_;			// cells to emit, in refinement order
+	std::vector<long long> corners_;	// sampleKey of every leaf corner, sorted
+	std::vector<int> boundary_;			// emitLeaf scratch, x,y pairs clockwise
+	std::vector<float> crossings_;		// emitLeaf scratch, x,y pairs in boundary order
+
+	std::list< Vec2<float> > isolineVertexList_;
+};
+
+
+#endif
@@ -0,0 +1,403 @@
+#include "ChunkedHeightMap.h"
+#include "MarchingSquares.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static const char CHUNK_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+static const uint32_t CHUNK_VERSION = 2;
+
+
+//
+static inline uint32_t floatBits(const float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+
+//
+static inline float bitsFloat(const uint32_t u)
+{
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+
+// xor of neighbouring samples has its noise in the low mantissa bits;
+// reversing moves the zeros to the top so the varint stays short
+static inline uint32_t reverseBits(uint32_t v)
+{
+	v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+	v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+	v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);
+	v = ((v >> 8) & 0x00FF00FFu) | ((v & 0x00FF00FFu) << 8);
+	return (v >> 16) | (v << 16);
+}
+
+
+//
+static bool fileSize(FILE* file, uint64_t& size)
+{
+#ifdef _WIN32
+	if (_fseeki64(file, 0, SEEK_END) != 0)
+		return false;
+
+	const long long end = _ftelli64(file);
+#else
+	if (fseeko(file, 0, SEEK_END) != 0)
+		return false;
+
+	const long long end = ftello(file);
+#endif
+
+	size = static_cast<uint64_t>(end);
+	return end >= 0;
+}
+
+
+// samples a chunk stores along one side: its cells plus the shared border
+static inline uint32_t chunkSamples(const uint32_t size, const uint32_t chunkSize, const uint32_t index)
+{
+	return std::min(chunkSize + 1, size - index*chunkSize);
+}
+
+
+//-----------------------------------------------------------------------------
+ChunkedHeightMap::ChunkedHeightMap()
+	:file_(NULL)
+{
+	memset(&header_, 0, sizeof(header_));
+}
+
+
+//
+ChunkedHeightMap::~ChunkedHeightMap()
+{
+	close();
+}
+
+
+//-----------------------------------------------------------------------------
+void ChunkedHeightMap::encodeXorVarint(const float* samples, const int count, std::vector<unsigned char>& out)
+{
+	uint32_t previous = 0;
+
+	for (int k = 0; k < count; ++k)
+	{
+		const uint32_t bits = floatBits(samples[k]);
+		uint32_t v = reverseBits(bits ^ previous);
+		previous = bits;
+
+		while (v >= 0x80)
+		{
+			out.push_back(static_cast<unsigned char>(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(static_cast<unsigned char>(v));
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+bool ChunkedHeightMap::decodeXorVarint(const unsigned char* in, const size_t size, float* samples, const int count)
+{
+	uint32_t previous = 0;
+	size_t pos = 0;
+
+	for (int k = 0; k < count; ++k)
+	{
+		uint32_t v = 0;
+		int shift = 0;
+
+		for (;;)
+		{
+			if (pos >= size || shift > 28)
+				return false;
+
+			const unsigned char byte = in[pos++];
+			v |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			shift += 7;
+
+			if (!(byte & 0x80))
+				break;
+		}
+
+		previous ^= reverseBits(v);
+		samples[k] = bitsFloat(previous);
+	}
+
+	return pos == size;
+}
+
+
+//-----------------------------------------------------------------------------
+bool ChunkedHeightMap::write(const std::string& filename, const GridView& view, const int chunkSize, const Compression compression)
+{
+	if (view.empty() || chunkSize < 1 || chunkSize > 32767)
+		return false;
+
+	ChunkFileHeader header;
+	memcpy(header.magic, CHUNK_MAGIC, sizeof(header.magic));
+	header.version = CHUNK_VERSION;
+	header.width = view.width;
+	header.height = view.height;
+	header.chunkSize = chunkSize;
+	header.chunksX = std::max(1, (view.width - 1 + chunkSize - 1) / chunkSize);
+	header.chunksY = std::max(1, (view.height - 1 + chunkSize - 1) / chunkSize);
+	header.compression = compression;
+	header.originX = view.originX;
+	header.originY = view.originY;
+
+	FILE* file = fopen(filename.c_str(), "wb");
+
+	if (file == NULL)
+		return false;
+
+	std::vector<ChunkRecord> records(header.chunksX*header.chunksY);
+	uint64_t offset = sizeof(header) + records.size()*sizeof(ChunkRecord);
+
+	// the table is written once the payload sizes are known
+	bool ok = fseek(file, static_cast<long>(offset), SEEK_SET) == 0;
+
+	std::vector<float> samples;
+	std::vector<unsigned char> encoded;
+
+	for (uint32_t cy = 0; ok && cy < header.chunksY; ++cy)
+	{
+		for (uint32_t cx = 0; ok && cx < header.chunksX; ++cx)
+		{
+			const int x0 = cx*chunkSize;
+			const int y0 = cy*chunkSize;
+			const int w = std::min(chunkSize + 1, view.width - x0);
+			const int h = std::min(chunkSize + 1, view.height - y0);
+
+			samples.resize(w*h);
+
+			for (int y = 0; y < h; ++y)
+				memcpy(&samples[y*w], view.row(y0 + y) + x0, w*sizeof(float));
+
+			ChunkRecord& record = records[cy*header.chunksX + cx];
+			record.offset = offset;
+			record.sampleWidth = static_cast<uint16_t>(w);
+			record.sampleHeight = static_cast<uint16_t>(h);
+			record.minValue = *std::min_element(samples.begin(), samples.end());
+			record.maxValue = *std::max_element(samples.begin(), samples.end());
+
+			const void* payload = &samples[0];
+			size_t payloadSize = samples.size()*sizeof(float);
+
+			if (compression == COMPRESSION_XOR_VARINT)
+			{
+				encoded.clear();
+				encodeXorVarint(&samples[0], w*h, encoded);
+				payload = &encoded[0];
+				payloadSize = encoded.size();
+			}
+
+			record.byteSize = static_cast<uint32_t>(payloadSize);
+			ok = fwrite(payload, 1, payloadSize, file) == payloadSize;
+			offset += payloadSize;
+		}
+	}
+
+	ok = ok && fseek(file, 0, SEEK_SET) == 0
+			&& fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(&records[0], sizeof(ChunkRecord), records.size(), file) == records.size();
+
+	return (fclose(file) == 0) && ok;
+}
+
+
+//-----------------------------------------------------------------------------
+bool ChunkedHeightMap::open(const std::string& filename)
+{
+	close();
+
+	file_ = fopen(filename.c_str(), "rb");
+
+	if (file_ == NULL)
+		return false;
+
+	uint64_t size = 0;
+
+	if (!fileSize(file_, size)
+		|| !readAt(0, &header_, sizeof(header_))
+		|| memcmp(header_.magic, CHUNK_MAGIC, sizeof(header_.magic)) != 0
+		|| header_.version != CHUNK_VERSION
+		|| !validateHeader(size))
+	{
+		close();
+		return false;
+	}
+
+	records_.resize(static_cast<size_t>(header_.chunksX)*header_.chunksY);
+
+	if (!readAt(sizeof(header_), &records_[0], records_.size()*sizeof(ChunkRecord))
+		|| !validateRecords(size))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool ChunkedHeightMap::validateHeader(const uint64_t fileSize) const
+{
+	const ChunkFileHeader& h = header_;
+
+	if (h.width < 1 || h.height < 1 || h.width > 0x7FFFFFFFu || h.height > 0x7FFFFFFFu
+		|| h.chunkSize < 1 || h.chunkSize > 32767 || h.compression > COMPRESSION_XOR_VARINT)
+		return false;
+
+	// the chunk grid follows from the dimensions, as in write()
+	if (h.chunksX != std::max(1u, (h.width - 1 + h.chunkSize - 1)/h.chunkSize)
+		|| h.chunksY != std::max(1u, (h.height - 1 + h.chunkSize - 1)/h.chunkSize))
+		return false;
+
+	const uint64_t count = static_cast<uint64_t>(h.chunksX)*h.chunksY;
+
+	return fileSize >= sizeof(h) && count <= (fileSize - sizeof(h))/sizeof(ChunkRecord);
+}
+
+
+//
+bool ChunkedHeightMap::validateRecords(const uint64_t fileSize) const
+{
+	const uint64_t tableEnd = sizeof(header_) + records_.size()*sizeof(ChunkRecord);
+
+	for (size_t k = 0; k < records_.size(); ++k)
+	{
+		const ChunkRecord& record = records_[k];
+		const uint32_t cx = static_cast<uint32_t>(k % header_.chunksX);
+		const uint32_t cy = static_cast<uint32_t>(k / header_.chunksX);
+
+		if (record.sampleWidth != chunkSamples(header_.width, header_.chunkSize, cx)
+			|| record.sampleHeight != chunkSamples(header_.height, header_.chunkSize, cy))
+			return false;
+
+		if (record.offset < tableEnd || record.offset > fileSize || record.byteSize > fileSize - record.offset)
+			return false;
+
+		// raw floats, or one to five varint bytes per sample
+		const uint64_t count = static_cast<uint64_t>(record.sampleWidth)*record.sampleHeight;
+
+		if (header_.compression == COMPRESSION_NONE
+			? record.byteSize != count*sizeof(float)
+			: (record.byteSize < count || record.byteSize > 5*count))
+			return false;
+	}
+
+	return true;
+}
+
+
+//
+void ChunkedHeightMap::close()
+{
+	if (file_ != NULL)
+		fclose(file_);
+
+	file_ = NULL;
+	records_.clear();
+	memset(&header_, 0, sizeof(header_));
+}
+
+
+//-----------------------------------------------------------------------------
+bool ChunkedHeightMap::readAt(const uint64_t offset, void* buffer, const size_t size)
+{
+#ifdef _WIN32
+	return _fseeki64(file_, offset, SEEK_SET) == 0 && fread(buffer, 1, size, file_) == size;
+#else
+	// positioned reads: no shared file cursor, only the bytes asked for
+	size_t done = 0;
+
+	while (done < size)
+	{
+		const ssize_t n = pread(fileno(file_), static_cast<char*>(buffer) + done, size - done, offset + done);
+
+		if (n <= 0)
+			return false;
+
+		done += n;
+	}
+
+	return true;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+bool ChunkedHeightMap::chunkStraddles(const int index, const float threshold) const
+{
+	// same test as MarchingSquares::evaluateCell: some corner above, some not
+	return records_[index].maxValue > threshold && records_[index].minValue <= threshold;
+}
+
+
+//-----------------------------------------------------------------------------
+bool ChunkedHeightMap::loadChunk(const int index, std::vector<float>& samples, GridView& view, int& frameX, int& frameY)
+{
+	const ChunkRecord& record = records_[index];
+	const int count = record.sampleWidth*record.sampleHeight;
+
+	samples.resize(count);
+
+	if (header_.compression == COMPRESSION_XOR_VARINT)
+	{
+		payload_.resize(record.byteSize);
+
+		if (!readAt(record.offset, &payload_[0], record.byteSize)
+			|| !decodeXorVarint(&payload_[0], record.byteSize, &samples[0], count))
+			return false;
+	}
+	else if (record.byteSize != count*sizeof(float) || !readAt(record.offset, &samples[0], record.byteSize))
+	{
+		return false;
+	}
+
+	view = GridView(&samples[0], record.sampleWidth, record.sampleHeight, record.sampleWidth);
+	frameX = header_.originX + static_cast<int>((index % header_.chunksX)*header_.chunkSize);
+	frameY = header_.originY + static_cast<int>((index / header_.chunksX)*header_.chunkSize);
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+int ChunkedHeightMap::computeIsolines(const float threshold, std::list< Vec2<float> >& vertexList)
+{
+	MarchingSquares marchingSquares;
+	std::vector<float> samples;
+	GridView view;
+	int frameX, frameY;
+	int chunksRead = 0;
+
+	vertexList.clear();
+
+	for (int k = 0; k < getChunkCount(); ++k)
+	{
+		if (!chunkStraddles(k, threshold))
+			continue;
+
+		if (!loadChunk(k, samples, view, frameX, frameY))
+			return -1;
+
+		marchingSquares.setGridView(view, frameX, frameY);
+		marchingSquares.computeIsolines(threshold);
+		vertexList.splice(vertexList.end(), *marchingSquares.getIsolineVertexList());
+		++chunksRead;
+	}
+
+	return chunksRead;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef CHUNKEDHEIGHTMAP_H_INCLUDED
+#define CHUNKEDHEIGHTMAP_H_INCLUDED
+
+#include "GridView.h"
+#include "Vec2.h"
+#include <stdint.h>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <vector>
+
+// Tiled on-disk heightmap store.
+//
+// Layout: ChunkFileHeader, chunksX*chunksY ChunkRecord entries (row-major),
+// then the chunk payloads. Chunk (cx, cy) owns the cells starting at
+// (cx*chunkSize, cy*chunkSize) and stores one extra row and column of
+// samples, so each chunk can be contoured on its own. The per-chunk min/max
+// lets extraction skip every chunk that cannot cross a threshold. The origin
+// of the written view is kept, so contours come out in its parent's frame.
+// open() checks the header and every record against the file size before
+// anything is read through them.
+
+struct ChunkFileHeader
+{
+	char     magic[4];		// "MSHC"
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t chunkSize;		// cells per chunk side
+	uint32_t chunksX;
+	uint32_t chunksY;
+	uint32_t compression;	// ChunkedHeightMap::Compression
+	int32_t  originX;		// view origin in its parent frame
+	int32_t  originY;
+};
+
+struct ChunkRecord
+{
+	uint64_t offset;		// payload position in the file
+	uint32_t byteSize;		// payload size in bytes
+	uint16_t sampleWidth;	// stored samples per row
+	uint16_t sampleHeight;	// stored rows
+	float    minValue;
+	float    maxValue;
+};
+
+class ChunkedHeightMap
+{
+public:
+
+	enum Compression
+	{
+		COMPRESSION_NONE = 0,
+		COMPRESSION_XOR_VARINT = 1	// lossless: xor with previous sample, bit-reversed LEB128
+	};
+
+	ChunkedHeightMap();
+	~ChunkedHeightMap();
+
+	// write a view of a heightmap as a chunked file
+	static bool write(const std::string& filename, const GridView& view, const int chunkSize = 256, const Compression compression = COMPRESSION_XOR_VARINT);
+
+	bool open(const std::string& filename);
+	void close();
+
+	inline bool isOpen() const { return file_ != NULL; };
+	inline const int getWidth() const { return header_.width; };
+	inline const int getHeight() const { return header_.height; };
+	inline const int getChunkSize() const { return header_.chunkSize; };
+	inline const int getOriginX() const { return header_.originX; };
+	inline const int getOriginY() const { return header_.originY; };
+	inline const int getChunkCount() const { return static_cast<int>(records_.size()); };
+	inline const ChunkRecord& getChunkRecord(const int index) const { return records_[index]; };
+
+	// true if the chunk contains a cell crossing the threshold
+	bool chunkStraddles(const int index, const float threshold) const;
+
+	// read and decode one chunk; the view is in the parent map's frame
+	bool loadChunk(const int index, std::vector<float>& samples, GridView& view, int& frameX, int& frameY);
+
+	// contour the map reading only the chunks whose range straddles the threshold;
+	// returns the number of chunks read, -1 on a read error
+	int computeIsolines(const float threshold, std::list< Vec2<float> >& vertexList);
+
+protected:
+
+	bool readAt(const uint64_t offset, void* buffer, const size_t size);
+	bool validateHeader(const uint64_t fileSize) const;
+	bool validateRecords(const uint64_t fileSize) const;
+
+	static void encodeXorVarint(const float* samples, const int count, std::vector<unsigned char>& out);
+	static bool decodeXorVarint(const unsigned char* in, const size_t size, float* samples, const int count);
+
+	FILE* file_;
+	ChunkFileHeader header_;
+	std::vector<ChunkRecord> records_;
+	std::vector<unsigned char> payload_;
+};
+
+
+#endif
@@ -0,0 +1,412 @@
+#include "ContourExport.h"
+#include "PerfCounters.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+
+//-----------------------------------------------------------------------------
+ContourWriter::ContourWriter()
+	:file_(NULL)
+	,buffer_(WRITE_BUFFER_SIZE)
+	,cursor_(&buffer_[0])
+	,end_(&buffer_[0] + WRITE_BUFFER_SIZE)
+	,precision_(3)
+	,bytesWritten_(0)
+	,seconds_(0.0)
+	,openTime_(0.0)
+	,skippedSegments_(0)
+	,ok_(false)
+{
+}
+
+
+//
+ContourWriter::~ContourWriter()
+{
+	// derived footers are gone by now: only release the file
+	if (file_ != NULL)
+		fclose(file_);
+}
+
+
+//-----------------------------------------------------------------------------
+bool ContourWriter::open(const std::string& filename)
+{
+	if (file_ != NULL)
+		close();
+
+	file_ = fopen(filename.c_str(), "wb");
+
+	if (file_ == NULL)
+		return false;
+
+	// the stdio buffer would only add a copy
+	setvbuf(file_, NULL, _IONBF, 0);
+
+	ok_ = true;
+	bytesWritten_ = 0;
+	skippedSegments_ = 0;
+	cursor_ = &buffer_[0];
+	openTime_ = PerfCounters::now();
+
+	writeHeader();
+	return true;
+}
+
+
+//
+bool ContourWriter::close()
+{
+	if (file_ == NULL)
+		return false;
+
+	writeFooter();
+	flush();
+
+	ok_ = (fclose(file_) == 0) && ok_;
+	file_ = NULL;
+	seconds_ = PerfCounters::now() - openTime_;
+
+	return ok_;
+}
+
+
+//
+double ContourWriter::getMegabytesPerSecond() const
+{
+	return (seconds_ > 0.0) ? getBytesWritten()/(seconds_*1e6) : 0.0;
+}
+
+
+//-----------------------------------------------------------------------------
+void ContourWriter::writeLevel(const float level, const std::list< Vec2<float> >& vertexList)
+{
+	beginLevel(level);
+
+	for (std::list< Vec2<float> >::const_iterator it = vertexList.begin(); it != vertexList.end(); ++it)
+	{
+		const Vec2<float>& p1 = *it;
+
+		if (++it == vertexList.end())
+			break;
+
+		segment(p1[0], p1[1], (*it)[0], (*it)[1]);
+	}
+
+	endLevel();
+}
+
+
+//-----------------------------------------------------------------------------
+void ContourWriter::flush()
+{
+	const size_t size = cursor_ - &buffer_[0];
+
+	if (size > 0 && file_ != NULL)
+		ok_ = (fwrite(&buffer_[0], 1, size, file_) == size) && ok_;
+
+	bytesWritten_ += size;
+	cursor_ = &buffer_[0];
+}
+
+
+//
+void ContourWriter::put(const char* text)
+{
+	while (*text)
+		put(*text++);
+}
+
+
+//
+void ContourWriter::putNumber(const double value, const int precision)
+{
+	// longest output below: sign, 20 integer digits, point, 9 decimals
+	if (end_ - cursor_ < 40)
+		flush();
+
+	// JSON has no NaN or infinity
+	if (!(value - value == 0.0))
+	{
+		put("null");
+		return;
+	}
+
+	if (precision < 0)
+	{
+#if __cplusplus >= 201703L
+		cursor_ = std::to_chars(cursor_, end_, value).ptr;
+#else
+		cursor_ += snprintf(cursor_, end_ - cursor_, "%.17g", value);
+#endif
+		return;
+	}
+
+	static const double powers[10] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+	const int decimals = (precision > 9) ? 9 : precision;
+	const double scaled = fabs(value)*powers[decimals] + 0.5;
+
+	if (!(scaled < 9e18))
+	{
+		putFixed(value, decimals);
+		return;
+	}
+
+	// fixed point by hand: integer digits backwards, then the decimals
+	unsigned long long units = static_cast<unsigned long long>(scaled);
+
+	if (value < 0.0 && units != 0)
+		*cursor_++ = '-';
+
+	char digits[24];
+	int n = 0;
+
+	do
+	{
+		digits[n++] = static_cast<char>('0' + units % 10);
+		units /= 10;
+	}
+	while (units != 0 || n <= decimals);
+
+	for (int k = n - 1; k >= decimals; --k)
+		*cursor_++ = digits[k];
+
+	if (decimals > 0)
+	{
+		*cursor_++ = '.';
+
+		for (int k = decimals - 1; k >= 0; --k)
+			*cursor_++ = digits[k];
+	}
+}
+
+
+//
+void ContourWriter::putShortest(const float value)
+{
+	if (end_ - cursor_ < 40)
+		flush();
+
+	if (!(value - value == 0.0f))
+	{
+		put("null");
+		return;
+	}
+
+#if __cplusplus >= 201703L
+	cursor_ = std::to_chars(cursor_, end_, value).ptr;
+#else
+	// fewest digits that read back to the same float; 9 always do
+	int n = 0;
+
+	for (int digits = 6; digits <= 9; ++digits)
+	{
+		n = snprintf(cursor_, end_ - cursor_, "%.*g", digits, value);
+
+		if (strtof(cursor_, NULL) == value)
+			break;
+	}
+
+	cursor_ += n;
+#endif
+}
+
+
+//
+void ContourWriter::putFixed(const double value, const int decimals)
+{
+	// up to ~320 characters for large values: print where it fits, or flush and retry
+	int n = snprintf(cursor_, end_ - cursor_, "%.*f", decimals, value);
+
+	if (n >= end_ - cursor_)
+	{
+		flush();
+		n = snprintf(cursor_, end_ - cursor_, "%.*f", decimals, value);
+	}
+
+	if (n < 0 || n >= end_ - cursor_)
+	{
+		ok_ = false;
+		return;
+	}
+
+	cursor_ += n;
+}
+
+
+//
+bool ContourWriter::transformSegment(const float x1, const float y1, const float x2, const float y2, double* points)
+{
+	points[0] = transform_.x(x1);
+	points[1] = transform_.y(y1);
+	points[2] = transform_.x(x2);
+	points[3] = transform_.y(y2);
+
+	for (int k = 0; k < 4; ++k)
+	{
+		if (!(points[k] - points[k] == 0.0))
+		{
+			++skippedSegments_;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+GeoJSONWriter::GeoJSONWriter()
+	:features_(0)
+	,firstSegment_(true)
+{
+}
+
+
+//
+void GeoJSONWriter::writeHeader()
+{
+	features_ = 0;
+	put("{\"type\":\"FeatureCollection\",\"features\":[");
+}
+
+
+//
+void GeoJSONWriter::writeFooter()
+{
+	put("]}\n");
+}
+
+
+//
+void GeoJSONWriter::beginLevel(const float level)
+{
+	if (features_++ > 0)
+		put(",\n");
+
+	put("{\"type\":\"Feature\",\"properties\":{\"level\":");
+
+	putShortest(level);
+
+	put("},\"geometry\":{\"type\":\"MultiLineString\",\"coordinates\":[");
+	firstSegment_ = true;
+}
+
+
+//
+void GeoJSONWriter::segment(const float x1, const float y1, const float x2, const float y2)
+{
+	double p[4];
+
+	if (!transformSegment(x1, y1, x2, y2, p))
+		return;
+
+	if (!firstSegment_)
+		put(',');
+
+	firstSegment_ = false;
+
+	put("[[");
+	putNumber(p[0], precision_);
+	put(',');
+	putNumber(p[1], precision_);
+	put("],[");
+	putNumber(p[2], precision_);
+	put(',');
+	putNumber(p[3], precision_);
+	put("]]");
+}
+
+
+//
+void GeoJSONWriter::endLevel()
+{
+	put("]}}");
+}
+
+
+//-----------------------------------------------------------------------------
+SVGWriter::SVGWriter(const int width, const int height)
+	:width_(width)
+	,height_(height)
+	,strokeWidth_(1.0f)
+	,lastX_(0.0f)
+	,lastY_(0.0f)
+	,hasLast_(false)
+{
+}
+
+
+//
+void SVGWriter::writeHeader()
+{
+	char header[256];
+	sprintf(header, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+			width_, height_, width_, height_);
+	put(header);
+}
+
+
+//
+void SVGWriter::writeFooter()
+{
+	put("</svg>\n");
+}
+
+
+//
+void SVGWriter::beginLevel(const float level)
+{
+	// same colour ramp as the viewer, level expected in [0,1] (NaN drawn as 0)
+	const float t = (level > 0.0f) ? (level < 1.0f ? level : 1.0f) : 0.0f;
+
+	char header[160];
+	sprintf(header, "<path fill=\"none\" stroke=\"rgb(%d,0,%d)\" stroke-width=\"%g\" data-level=\"%g\" d=\"",
+			static_cast<int>(t*255.0f + 0.5f), static_cast<int>((1.0f - t)*255.0f + 0.5f), strokeWidth_, level);
+	put(header);
+
+	hasLast_ = false;
+}
+
+
+//
+void SVGWriter::segment(const float x1, const float y1, const float x2, const float y2)
+{
+	double p[4];
+
+	if (!transformSegment(x1, y1, x2, y2, p))
+		return;
+
+	// skip the move when the segment continues the previous one
+	if (!hasLast_ || x1 != lastX_ || y1 != lastY_)
+	{
+		put('M');
+		putNumber(p[0], precision_);
+		put(' ');
+		putNumber(p[1], precision_);
+	}
+
+	put('L');
+	putNumber(p[2], precision_);
+	put(' ');
+	putNumber(p[3], precision_);
+
+	lastX_ = x2;
+	lastY_ = y2;
+	hasLast_ = true;
+}
+
+
+//
+void SVGWriter::endLevel()
+{
+	put("\"/>\n");
+}
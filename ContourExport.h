@@ -0,0 +1,156 @@
+#pragma once
+#ifndef CONTOUREXPORT_H_INCLUDED
+#define CONTOUREXPORT_H_INCLUDED
+
+#include "Vec2.h"
+#include <cstdio>
+#include <list>
+#include <string>
+#include <vector>
+
+// Streaming GeoJSON/SVG writers for isolines.
+//
+// Segments are formatted straight into a fixed-size buffer that is flushed
+// with large fwrite calls, so memory use does not depend on the number of
+// contours. Each level becomes one GeoJSON MultiLineString feature or one
+// SVG path. Coordinates go through an optional pixel-to-world transform and
+// are printed with a fixed number of decimals, or with the shortest text
+// that reads back to the same double when precision is negative. Segments
+// with a NaN or infinite coordinate are skipped and counted; other
+// non-finite numbers (e.g. a NaN level) are written as null.
+
+struct CoordinateTransform
+{
+	CoordinateTransform() : originX(0.0), originY(0.0), scaleX(1.0), scaleY(1.0) {}
+	CoordinateTransform(const double ox, const double oy, const double sx, const double sy)
+		: originX(ox), originY(oy), scaleX(sx), scaleY(sy) {}
+
+	inline double x(const float px) const { return originX + px*scaleX; }
+	inline double y(const float py) const { return originY + py*scaleY; }
+
+	double originX;
+	double originY;
+	double scaleX;
+	double scaleY;
+};
+
+class ContourWriter
+{
+public:
+
+	ContourWriter();
+	virtual ~ContourWriter();
+
+	// open() writes the header, close() the footer and the last buffer
+	bool open(const std::string& filename);
+	bool close();
+
+	inline bool isOpen() const { return file_ != NULL; };
+	inline void setTransform(const CoordinateTransform& transform) { transform_ = transform; };
+	inline void setPrecision(const int decimals) { precision_ = decimals; };
+
+	virtual void beginLevel(const float level) = 0;
+	virtual void segment(const float x1, const float y1, const float x2, const float y2) = 0;
+	virtual void endLevel() = 0;
+
+	// segment sink for MarchingSquares::computeIsolines(threshold, sink);
+	// call beginLevel() before and endLevel() after the extraction
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int, const int, const float)
+	{
+		segment(x1, y1, x2, y2);
+	}
+
+	// one level from a vertex list (pairs of segment end points)
+	void writeLevel(const float level, const std::list< Vec2<float> >& vertexList);
+
+	// segments dropped for a non-finite coordinate since open()
+	inline long long getSkippedSegments() const { return skippedSegments_; };
+
+	inline unsigned long long getBytesWritten() const { return bytesWritten_ + (cursor_ - &buffer_[0]); };
+	inline double getSeconds() const { return seconds_; };
+	double getMegabytesPerSecond() const;
+
+protected:
+
+	virtual void writeHeader() = 0;
+	virtual void writeFooter() = 0;
+
+	inline void put(const char c)
+	{
+		if (cursor_ == end_)
+			flush();
+		*cursor_++ = c;
+	}
+
+	void put(const char* text);
+	void putNumber(const double value, const int precision);
+	void putShortest(const float value);		// levels: shortest text of the float
+	void putFixed(const double value, const int decimals);
+	void flush();
+
+	// transformed end points of a segment; false (and counted) if one is not finite
+	bool transformSegment(const float x1, const float y1, const float x2, const float y2, double* points);
+
+	FILE* file_;
+	std::vector<char> buffer_;
+	char* cursor_;
+	char* end_;
+	CoordinateTransform transform_;
+	int precision_;
+	unsigned long long bytesWritten_;
+	double seconds_;
+	double openTime_;
+	long long skippedSegments_;
+	bool ok_;
+};
+
+class GeoJSONWriter : public ContourWriter
+{
+public:
+
+	GeoJSONWriter();
+
+	using ContourWriter::segment;
+
+	virtual void beginLevel(const float level);
+	virtual void segment(const float x1, const float y1, const float x2, const float y2);
+	virtual void endLevel();
+
+protected:
+
+	virtual void writeHeader();
+	virtual void writeFooter();
+
+	int features_;
+	bool firstSegment_;
+};
+
+class SVGWriter : public ContourWriter
+{
+public:
+
+	SVGWriter(const int width, const int height);
+
+	inline void setStrokeWidth(const float strokeWidth) { strokeWidth_ = strokeWidth; };
+
+	using ContourWriter::segment;
+
+	virtual void beginLevel(const float level);
+	virtual void segment(const float x1, const float y1, const float x2, const float y2);
+	virtual void endLevel();
+
+protected:
+
+	virtual void writeHeader();
+	virtual void writeFooter();
+
+	int width_;
+	int height_;
+	float strokeWidth_;
+	float lastX_;
+	float lastY_;
+	bool hasLast_;
+};
+
+
+#endif
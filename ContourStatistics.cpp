@@ -0,0 +1,203 @@
+#include "ContourStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if __cplusplus >= 201103L
+#include <thread>
+#endif
+
+// corners a, b, c, d in walking order around the cell
+static const float CORNER_X[4] = { 0.0f, 1.0f, 1.0f, 0.0f };
+static const float CORNER_Y[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+
+//-----------------------------------------------------------------------------
+ContourStatistics::ContourStatistics()
+	:threads_(0)
+	,cells_(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void ContourStatistics::compute(const GridView& view, const float level)
+{
+	compute(view, std::vector<float>(1, level));
+}
+
+
+//
+void ContourStatistics::compute(const GridView& view, const std::vector<float>& levels)
+{
+	levels_ = levels;
+	std::sort(levels_.begin(), levels_.end());
+
+	const int levelCount = static_cast<int>(levels_.size());
+	const int cellsY = (view.empty() || view.width < 2) ? 0 : view.height - 1;
+
+	cells_ = static_cast<long long>(std::max(view.width - 1, 0))*cellsY;
+	bands_.assign((cellsY + BAND_ROWS - 1)/BAND_ROWS, Band());
+
+	for (size_t b = 0; b < bands_.size(); ++b)
+	{
+		Band& band = bands_[b];
+		band.lowest.assign(levelCount + 1, 0);
+		band.crossing.assign(levelCount, 0);
+		band.segments.assign(levelCount, 0);
+		band.length.assign(levelCount, 0.0);
+		band.area.assign(levelCount, 0.0);
+	}
+
+	int threads = threads_;
+
+#if __cplusplus >= 201103L
+	if (threads <= 0)
+		threads = static_cast<int>(std::thread::hardware_concurrency());
+#endif
+
+	threads = std::min(std::max(threads, 1), std::max(static_cast<int>(bands_.size()), 1));
+
+#if __cplusplus >= 201103L
+	std::vector<std::thread> workers;
+
+	for (int t = 1; t < threads; ++t)
+		workers.push_back(std::thread(&ContourStatistics::computeBands, this, view, t, threads));
+
+	computeBands(view, 0, threads);
+
+	for (size_t t = 0; t < workers.size(); ++t)
+		workers[t].join();
+#else
+	computeBands(view, 0, 1);
+#endif
+
+	// reduce in band order
+	statistics_.assign(levelCount, ContourLevelStatistics());
+	std::vector<long long> lowest(levelCount + 1, 0);
+
+	for (size_t b = 0; b < bands_.size(); ++b)
+	{
+		const Band& band = bands_[b];
+
+		for (int k = 0; k < levelCount; ++k)
+		{
+			statistics_[k].crossingCells += band.crossing[k];
+			statistics_[k].segments += band.segments[k];
+			statistics_[k].length += band.length[k];
+			statistics_[k].area += band.area[k];
+		}
+
+		for (int k = 0; k <= levelCount; ++k)
+			lowest[k] += band.lowest[k];
+	}
+
+	// cells whose minimum is above level k are entirely above it
+	long long above = 0;
+
+	for (int k = levelCount - 1; k >= 0; --k)
+	{
+		above += lowest[k + 1];
+		statistics_[k].level = levels_[k];
+		statistics_[k].area += above;
+	}
+
+	std::vector<Band>().swap(bands_);
+}
+
+
+//-----------------------------------------------------------------------------
+void ContourStatistics::computeBands(const GridView& view, const int first, const int step)
+{
+	const int cellsY = view.height - 1;
+
+	for (int b = first; b < static_cast<int>(bands_.size()); b += step)
+		computeBand(view, bands_[b], b*BAND_ROWS, std::min((b + 1)*BAND_ROWS, cellsY));
+}
+
+
+//
+void ContourStatistics::computeBand(const GridView& view, Band& band, const int y0, const int y1) const
+{
+	const float* levels = levels_.empty() ? NULL : &levels_[0];
+	const float* levelsEnd = levels + levels_.size();
+	const int cellsX = view.width - 1;
+
+	for (int y = y0; y < y1; ++y)
+	{
+		const float* row0 = view.row(y);
+		const float* row1 = view.row(y + 1);
+
+		for (int x = 0; x < cellsX; ++x)
+		{
+			const float v[4] = { row0[x], row0[x + 1], row1[x + 1], row1[x] };
+			const float lo = std::min(std::min(v[0], v[1]), std::min(v[2], v[3]));
+			const float hi = std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+
+			// levels in [lo, hi) cross the cell, the ones below lo are all above
+			const float* first = std::lower_bound(levels, levelsEnd, lo);
+			const float* last = std::lower_bound(first, levelsEnd, hi);
+
+			++band.lowest[first - levels];
+
+			for (const float* level = first; level < last; ++level)
+			{
+				const float threshold = *level;
+				const int k = static_cast<int>(level - levels);
+
+				// same classification as computeIsolines(): a=1, b=8, c=4, d=2
+				const bool above[4] = { v[0] > threshold, v[1] > threshold, v[2] > threshold, v[3] > threshold };
+				const bool saddle = above[0] == above[2] && above[1] == above[3] && above[0] != above[1];
+
+				// walk the border keeping the corners above (below for a saddle,
+				// whose corners above are separated) and the crossings
+				float px[8], py[8], ex[4], ey[4];
+				int points = 0, crossings = 0;
+
+				for (int i = 0; i < 4; ++i)
+				{
+					const int j = (i + 1) & 3;
+
+					if (above[i] != saddle)
+					{
+						px[points] = CORNER_X[i];
+						py[points++] = CORNER_Y[i];
+					}
+
+					if (above[i] != above[j])
+					{
+						const float t = (threshold - v[i])/(v[j] - v[i]);
+						ex[crossings] = CORNER_X[i] + t*(CORNER_X[j] - CORNER_X[i]);
+						ey[crossings++] = CORNER_Y[i] + t*(CORNER_Y[j] - CORNER_Y[i]);
+						px[points] = ex[crossings - 1];
+						py[points++] = ey[crossings - 1];
+					}
+				}
+
+				float twiceArea = 0.0f;
+
+				for (int i = 0, j = points - 1; i < points; j = i++)
+					twiceArea += px[j]*py[i] - px[i]*py[j];
+
+				const float area = 0.5f*fabsf(twiceArea);
+				float length;
+
+				if (!saddle)
+					length = sqrtf((ex[1] - ex[0])*(ex[1] - ex[0]) + (ey[1] - ey[0])*(ey[1] - ey[0]));
+				else
+				{
+					// crossings on ab, bc, cd, da; each segment cuts off a corner above
+					const int s = above[0] ? 3 : 0;
+					const int t = (s + 1) & 3, u = (s + 2) & 3, w = (s + 3) & 3;
+					length = sqrtf((ex[t] - ex[s])*(ex[t] - ex[s]) + (ey[t] - ey[s])*(ey[t] - ey[s]))
+						   + sqrtf((ex[w] - ex[u])*(ex[w] - ex[u]) + (ey[w] - ey[u])*(ey[w] - ey[u]));
+				}
+
+				++band.crossing[k];
+				band.segments[k] += saddle ? 2 : 1;
+				band.length[k] += length;
+				band.area[k] += saddle ? 1.0f - area : area;
+			}
+		}
+	}
+}
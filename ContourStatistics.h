@@ -0,0 +1,77 @@
+#pragma once
+#ifndef CONTOURSTATISTICS_H_INCLUDED
+#define CONTOURSTATISTICS_H_INCLUDED
+
+#include "GridView.h"
+#include <vector>
+
+// Per-level contour metrics without building any geometry.
+//
+// compute() makes one pass over the cells for all levels at once. A cell
+// whose corners are all above a level only adds to that level's area, so
+// those levels are counted in a histogram of the cell minimum; only the
+// levels within [min, max) of the cell are classified, and for them the
+// segment lengths (as computeIsolines() would produce them, saddles
+// separating the corners above) and the area of the cell above the level
+// are accumulated directly. The area over all levels is the hypsometric
+// curve of the view. Rows are split in fixed bands spread over threads and
+// the band sums are reduced in order, so results do not depend on the
+// thread count.
+
+struct ContourLevelStatistics
+{
+	ContourLevelStatistics() : level(0.0f), crossingCells(0), segments(0), length(0.0), area(0.0) {}
+
+	float level;
+	long long crossingCells;	// cells the isoline passes through
+	long long segments;			// saddle cells give two
+	double length;				// in sample spacings
+	double area;				// above the level, in cells
+};
+
+class ContourStatistics
+{
+public:
+
+	// cell rows per band, the unit of work and of the reduction
+	static const int BAND_ROWS = 32;
+
+	ContourStatistics();
+
+	// 0: one per hardware thread
+	inline void setThreads(const int threads) { threads_ = threads; };
+
+	// levels in any order; results come sorted by level
+	void compute(const GridView& view, const std::vector<float>& levels);
+	void compute(const GridView& view, const float level);
+
+	inline int getLevelCount() const { return static_cast<int>(statistics_.size()); };
+	inline const ContourLevelStatistics& get(const int k) const { return statistics_[k]; };
+	inline const std::vector<ContourLevelStatistics>& getStatistics() const { return statistics_; };
+
+	// cells in the view, i.e. the area below the lowest sample
+	inline long long getCellCount() const { return cells_; };
+
+protected:
+
+	struct Band
+	{
+		std::vector<long long> lowest;		// cells by the first level >= their minimum
+		std::vector<long long> crossing;
+		std::vector<long long> segments;
+		std::vector<double> length;
+		std::vector<double> area;			// partial cells only
+	};
+
+	void computeBands(const GridView& view, const int first, const int step);
+	void computeBand(const GridView& view, Band& band, const int y0, const int y1) const;
+
+	int threads_;
+	long long cells_;
+	std::vector<float> levels_;
+	std::vector<Band> bands_;
+	std::vector<ContourLevelStatistics> statistics_;
+};
+
+
+#endif
@@ -0,0 +1,323 @@
+#include "ContourTree.h"
+#include "Vec2.h"
+
+#include <algorithm>
+#include <deque>
+#include <set>
+
+// sweep order for the join tree: higher values first, ties broken by index
+// (simulation of simplicity) so every vertex has a distinct position
+struct DescendingVertex
+{
+	DescendingVertex(const std::vector<float>& v) : values(v) {}
+
+	inline bool operator () (const int lhs, const int rhs) const
+	{
+		if (values[lhs] != values[rhs])
+			return values[lhs] > values[rhs];
+		return lhs > rhs;
+	}
+
+	const std::vector<float>& values;
+};
+
+
+//
+static inline int findRoot(std::vector<int>& parent, int v)
+{
+	while (parent[v] != v)
+	{
+		parent[v] = parent[parent[v]];
+		v = parent[v];
+	}
+	return v;
+}
+
+
+//-----------------------------------------------------------------------------
+ContourTree::ContourTree()
+	:width_(0)
+	,height_(0)
+{
+}
+
+
+//
+ContourTree::~ContourTree()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void ContourTree::build(const GridView& view)
+{
+	width_ = view.width;
+	height_ = view.height;
+
+	values_.resize(width_*height_);
+
+	for (int y = 0; y < height_; ++y)
+		std::copy(view.row(y), view.row(y) + width_, values_.begin() + y*width_);
+
+	std::vector<int> order;
+	order.reserve(values_.size());
+
+	for (int v = 0; v < static_cast<int>(values_.size()); ++v)
+	{
+		if (!isNAN(values_[v]))
+			order.push_back(v);
+	}
+
+	std::sort(order.begin(), order.end(), DescendingVertex(values_));
+	sweep(ABOVE, order);
+
+	std::reverse(order.begin(), order.end());
+	sweep(BELOW, order);
+}
+
+
+//-----------------------------------------------------------------------------
+void ContourTree::sweep(const Side side, const std::vector<int>& order)
+{
+	// regions above a level are 4-connected, basins below it 8-connected,
+	// matching how MarchingSquares resolves the saddle cases 5 and 10
+	static const int dx[8] = { -1, 1,  0, 0, -1,  1, -1, 1 };
+	static const int dy[8] = {  0, 0, -1, 1, -1, -1,  1, 1 };
+	const int neighbours = (side == ABOVE) ? 4 : 8;
+
+	Tree& tree = trees_[side];
+	tree.arcs.clear();
+	tree.events.clear();
+	tree.merges.clear();
+
+	const int n = static_cast<int>(values_.size());
+	std::vector<int> parent(n, -1);		// -1: not swept yet
+	std::vector<int> rootArc(n, -1);
+	std::vector<int> arcOfPosition(order.size());
+	int count = 0;
+
+	for (size_t pos = 0; pos < order.size(); ++pos)
+	{
+		const int v = order[pos];
+		const int x = v % width_;
+		const int y = v / width_;
+
+		int roots[8];
+		int rootCount = 0;
+
+		for (int k = 0; k < neighbours; ++k)
+		{
+			const int nx = x + dx[k];
+			const int ny = y + dy[k];
+
+			if (nx < 0 || ny < 0 || nx >= width_ || ny >= height_ || parent[ny*width_ + nx] < 0)
+				continue;
+
+			const int r = findRoot(parent, ny*width_ + nx);
+
+			if (std::find(roots, roots + rootCount, r) == roots + rootCount)
+				roots[rootCount++] = r;
+		}
+
+		parent[v] = v;
+
+		if (rootCount == 1)
+		{
+			parent[v] = roots[0];
+			arcOfPosition[pos] = rootArc[roots[0]];
+			continue;
+		}
+
+		// birth (no swept neighbour) or merge: v starts a new arc
+		Arc arc;
+		arc.upper = v;
+		arc.lower = -1;
+		arc.next = -1;
+		arc.first = 0;
+		arc.count = 0;
+
+		const int arcIndex = static_cast<int>(tree.arcs.size());
+
+		for (int k = 0; k < rootCount; ++k)
+		{
+			tree.arcs[rootArc[roots[k]]].lower = v;
+			tree.arcs[rootArc[roots[k]]].next = arcIndex;
+			parent[roots[k]] = v;
+		}
+
+		tree.arcs.push_back(arc);
+		rootArc[v] = arcIndex;
+		arcOfPosition[pos] = arcIndex;
+
+		count += 1 - rootCount;
+
+		if (rootCount > 1)
+		{
+			MergeEvent merge;
+			merge.vertex = v;
+			merge.value = values_[v];
+			merge.merged = rootCount;
+			tree.merges.push_back(merge);
+		}
+
+		SweepEvent event;
+		event.value = values_[v];
+		event.count = count;
+		tree.events.push_back(event);
+	}
+
+	// group the swept vertices by arc, keeping sweep order inside each arc
+	for (size_t pos = 0; pos < order.size(); ++pos)
+		++tree.arcs[arcOfPosition[pos]].count;
+
+	int first = 0;
+
+	for (size_t a = 0; a < tree.arcs.size(); ++a)
+	{
+		tree.arcs[a].first = first;
+		first += tree.arcs[a].count;
+		tree.arcs[a].count = 0;
+	}
+
+	tree.vertices.resize(order.size());
+
+	for (size_t pos = 0; pos < order.size(); ++pos)
+	{
+		Arc& arc = tree.arcs[arcOfPosition[pos]];
+		tree.vertices[arc.first + arc.count++] = order[pos];
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+int ContourTree::componentCount(const Side side, const float level) const
+{
+	const std::vector<SweepEvent>& events = trees_[side].events;
+
+	// events are in sweep order: the ones inside the level form a prefix
+	int lo = 0;
+	int hi = static_cast<int>(events.size());
+
+	while (lo < hi)
+	{
+		const int mid = (lo + hi)/2;
+
+		if (inside(side, events[mid].value, level))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return (lo > 0) ? events[lo - 1].count : 0;
+}
+
+
+//-----------------------------------------------------------------------------
+void ContourTree::components(const Side side, const float level, std::vector<Component>& out) const
+{
+	const Tree& tree = trees_[side];
+
+	out.clear();
+
+	for (size_t a = 0; a < tree.arcs.size(); ++a)
+	{
+		const Arc& arc = tree.arcs[a];
+
+		// arcs are in birth order: the rest is born past the level
+		if (!inside(side, values_[arc.upper], level))
+			break;
+
+		if (arc.lower >= 0 && inside(side, values_[arc.lower], level))
+			continue;
+
+		// last vertex of the arc still inside the level
+		int lo = arc.first;
+		int hi = arc.first + arc.count;
+
+		while (lo < hi)
+		{
+			const int mid = (lo + hi)/2;
+
+			if (inside(side, values_[tree.vertices[mid]], level))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		Component component;
+		component.arc = static_cast<int>(a);
+		component.seed = tree.vertices[lo - 1];
+		out.push_back(component);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+int ContourTree::containingArc(const Side side, const int arc, const float level) const
+{
+	const Tree& tree = trees_[side];
+
+	if (!inside(side, values_[tree.arcs[arc].upper], level))
+		return -1;
+
+	int current = arc;
+
+	while (tree.arcs[current].lower >= 0 && inside(side, values_[tree.arcs[current].lower], level))
+		current = tree.arcs[current].next;
+
+	return current;
+}
+
+
+//-----------------------------------------------------------------------------
+bool ContourTree::seedCell(const Side side, const Component& component, const float level, int& cellX, int& cellY) const
+{
+	static const int dx[8] = { -1, 1,  0, 0, -1,  1, -1, 1 };
+	static const int dy[8] = {  0, 0, -1, 1, -1, -1,  1, 1 };
+	const int neighbours = (side == ABOVE) ? 4 : 8;
+
+	// the seed is the component vertex closest to the level, so the search
+	// usually stops at once; it only spreads inside plateaus and pits
+	std::deque<int> queue(1, component.seed);
+	std::set<int> visited;
+	visited.insert(component.seed);
+
+	while (!queue.empty())
+	{
+		const int v = queue.front();
+		queue.pop_front();
+
+		const int x = v % width_;
+		const int y = v / width_;
+
+		// an edge to an outside 4-neighbour crosses the level
+		for (int k = 0; k < 4; ++k)
+		{
+			const int nx = x + dx[k];
+			const int ny = y + dy[k];
+
+			if (nx < 0 || ny < 0 || nx >= width_ || ny >= height_ || inside(side, values_[ny*width_ + nx], level))
+				continue;
+
+			cellX = std::min(std::min(x, nx), width_ - 2);
+			cellY = std::min(std::min(y, ny), height_ - 2);
+			return cellX >= 0 && cellY >= 0;
+		}
+
+		for (int k = 0; k < neighbours; ++k)
+		{
+			const int nx = x + dx[k];
+			const int ny = y + dy[k];
+
+			if (nx < 0 || ny < 0 || nx >= width_ || ny >= height_)
+				continue;
+
+			const int w = ny*width_ + nx;
+
+			if (inside(side, values_[w], level) && visited.insert(w).second)
+				queue.push_back(w);
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#ifndef CONTOURTREE_H_INCLUDED
+#define CONTOURTREE_H_INCLUDED
+
+#include "GridView.h"
+#include <vector>
+
+// Join/split trees of a heightmap for topological queries at any level.
+//
+// Built once by sweeping the sorted samples with union-find. The join tree
+// tracks the regions above a level (value > t, 4-connected, the same regions
+// MarchingSquares separates on saddle cells), the split tree the basins
+// below it (value <= t, 8-connected). Component counts are answered by a
+// binary search over the sweep events; listing components walks only the
+// arcs born above (or below) the level.
+
+class ContourTree
+{
+public:
+
+	enum Side
+	{
+		ABOVE = 0,	// join tree: value > t
+		BELOW = 1	// split tree: value <= t
+	};
+
+	// arc of a join or split tree: the piece of one component between
+	// its birth node (maximum/minimum or merge) and the merge it flows into
+	struct Arc
+	{
+		int upper;		// vertex where the arc starts in sweep order
+		int lower;		// vertex where it merges, -1 if it survives to the end
+		int next;		// arc continuing after the merge, -1 if none
+		int first;		// range of its vertices in the sweep-ordered vertex list
+		int count;
+	};
+
+	// a component of the region above/below a level
+	struct Component
+	{
+		int arc;		// arc spanning the level
+		int seed;		// vertex of the component closest to the level
+	};
+
+	// merge of two or more components
+	struct MergeEvent
+	{
+		int vertex;
+		float value;
+		int merged;		// number of components joined
+	};
+
+	ContourTree();
+	~ContourTree();
+
+	void build(const GridView& view);
+
+	inline bool empty() const { return trees_[ABOVE].arcs.empty(); };
+	inline const int getWidth() const { return width_; };
+	inline const int getHeight() const { return height_; };
+	inline const Arc& getArc(const Side side, const int arc) const { return trees_[side].arcs[arc]; };
+	inline const std::vector<MergeEvent>& getMergeEvents(const Side side) const { return trees_[side].merges; };
+
+	// number of separate regions above/below the level, O(log n)
+	int componentCount(const Side side, const float level) const;
+
+	// components at the level with a seed vertex each, O(arcs born before the level)
+	void components(const Side side, const float level, std::vector<Component>& out) const;
+
+	// component at a level further along the sweep containing the given
+	// component (nesting), -1 if the level is not reached
+	int containingArc(const Side side, const int arc, const float level) const;
+
+	// cell (x, y) whose edge crosses the level next to a component seed, so
+	// a single contour can be traced from it; false if none was found
+	bool seedCell(const Side side, const Component& component, const float level, int& cellX, int& cellY) const;
+
+	inline float valueAt(const int vertex) const { return values_[vertex]; };
+
+protected:
+
+	struct SweepEvent
+	{
+		float value;
+		int count;		// components after the event
+	};
+
+	struct Tree
+	{
+		std::vector<Arc> arcs;				// in order of birth
+		std::vector<int> vertices;			// vertices grouped by arc, sweep order inside
+		std::vector<SweepEvent> events;		// births and merges in sweep order
+		std::vector<MergeEvent> merges;
+	};
+
+	void sweep(const Side side, const std::vector<int>& order);
+
+	// true if the value is inside the region at the level
+	static inline bool inside(const Side side, const float value, const float level)
+	{
+		return (side == ABOVE) ? (value > level) : (value <= level);
+	}
+
+	int width_;
+	int height_;
+	std::vector<float> values_;
+	Tree trees_[2];
+};
+
+
+#endif
@@ -0,0 +1,288 @@
+#include "GridAnalysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+
+// floats in order as unsigned keys, for bisecting over every float
+static inline uint32_t floatKey(const float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+
+//
+static inline float keyFloat(const uint32_t key)
+{
+	const uint32_t u = (key & 0x80000000u) ? (key & 0x7FFFFFFFu) : ~key;
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+
+//
+static void cellIntervals(const int* __restrict edges0, const int* __restrict edges1, const int cells,
+						  int* __restrict first, int* __restrict last, int* __restrict low, int* __restrict high)
+{
+	// a threshold at edge k crosses the cell when min <= edge(k) < max;
+	// case 5 (a, c above) needs max(b,d) <= t < min(a,c), case 10 max(a,c) <= t < min(b,d).
+	// At most one of those is non-empty, and then its bounds are the lower
+	// of the two maxima and the higher of the two minima; when both are
+	// empty the same expressions give an empty interval. Only min/max, so
+	// the loop vectorizes.
+	for (int i = 0; i < cells; ++i)
+	{
+		const int a = edges0[i];
+		const int b = edges0[i+1];
+		const int c = edges1[i+1];
+		const int d = edges1[i];
+
+		const int maxBD = (b > d) ? b : d;
+		const int maxAC = (a > c) ? a : c;
+		const int minAC = (a < c) ? a : c;
+		const int minBD = (b < d) ? b : d;
+		const int saddleLow = (maxBD < maxAC) ? maxBD : maxAC;
+		const int saddleHigh = (minAC > minBD) ? minAC : minBD;
+
+		first[i] = (minAC < minBD) ? minAC : minBD;
+		last[i] = (maxBD > maxAC) ? maxBD : maxAC;
+		low[i] = saddleLow;
+		high[i] = (saddleHigh > saddleLow) ? saddleHigh : saddleLow;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+GridAnalysis::GridAnalysis()
+	:bins_(0)
+	,minValue_(0.0f)
+	,maxValue_(0.0f)
+	,step_(0.0f)
+	,invStep_(0.0f)
+	,top_(1.0f)
+	,samples_(0)
+	,cells_(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void GridAnalysis::analyze(const GridView& view, const int bins)
+{
+	float minValue = 0.0f;
+	float maxValue = 0.0f;
+
+	if (!view.empty())
+	{
+		// eight running lanes written as selects: the loop vectorizes to min/max
+		float lo[8], hi[8];
+
+		for (int j = 0; j < 8; ++j)
+			lo[j] = hi[j] = view.at(0, 0);
+
+		for (int y = 0; y < view.height; ++y)
+		{
+			const float* __restrict row = view.row(y);
+			int x = 0;
+
+			for (; x + 8 <= view.width; x += 8)
+			{
+				for (int j = 0; j < 8; ++j)
+				{
+					lo[j] = (row[x + j] < lo[j]) ? row[x + j] : lo[j];
+					hi[j] = (row[x + j] > hi[j]) ? row[x + j] : hi[j];
+				}
+			}
+
+			for (; x < view.width; ++x)
+			{
+				lo[0] = (row[x] < lo[0]) ? row[x] : lo[0];
+				hi[0] = (row[x] > hi[0]) ? row[x] : hi[0];
+			}
+		}
+
+		minValue = *std::min_element(lo, lo + 8);
+		maxValue = *std::max_element(hi, hi + 8);
+	}
+
+	analyze(view, bins, minValue, maxValue);
+}
+
+
+//
+void GridAnalysis::analyze(const GridView& view, const int bins, const float minValue, const float maxValue)
+{
+	bins_ = std::max(bins, 1);
+	minValue_ = minValue;
+	maxValue_ = std::max(minValue, maxValue);
+	step_ = (maxValue_ - minValue_)/bins_;
+	invStep_ = (step_ > 0.0f) ? 1.0f/step_ : 0.0f;
+	top_ = static_cast<float>(bins_ + 1);
+	samples_ = static_cast<long long>(view.width)*view.height;
+	cells_ = static_cast<long long>(std::max(view.width - 1, 0))*std::max(view.height - 1, 0);
+
+	// the maximum belongs to the last edge whatever the rounding of the multiply
+	while (invStep_ > 0.0f && edgeIndex(maxValue_) > bins_)
+		invStep_ = nextafterf(invStep_, 0.0f);
+
+	// edge k: the largest float whose index is k or below
+	edges_.assign(bins_ + 1, minValue_);
+
+	for (int k = 0; invStep_ > 0.0f && k <= bins_; ++k)
+	{
+		uint32_t below = floatKey(-std::numeric_limits<float>::max());
+		uint32_t above = floatKey(std::numeric_limits<float>::max());
+
+		if (edgeIndex(keyFloat(above)) <= k)
+			below = above;
+
+		while (above - below > 1)
+		{
+			const uint32_t middle = below + (above - below)/2;
+
+			if (edgeIndex(keyFloat(middle)) <= k)
+				below = middle;
+			else
+				above = middle;
+		}
+
+		edges_[k] = keyFloat(below);
+	}
+
+	histogram_.assign(bins_ + 2, 0);
+	active_.assign(bins_ + 2, 0);
+	segments_.assign(bins_ + 2, 0);
+	rowEdges_.resize(6*static_cast<size_t>(std::max(view.width, 1)));
+
+	long long* __restrict histogram = &histogram_[0];
+	long long* __restrict active = &active_[0];
+	long long* __restrict segments = &segments_[0];
+
+	const int width = view.width;
+	const int cells = width - 1;
+	const float origin = minValue_;
+	const float invStep = invStep_;
+	const float top = top_;
+	int* __restrict first = &rowEdges_[2*static_cast<size_t>(width)];
+	int* __restrict last = first + width;
+	int* __restrict low = last + width;
+	int* __restrict high = low + width;
+
+	for (int y = 0; y < view.height; ++y)
+	{
+		const float* row = view.row(y);
+		int* __restrict edges1 = &rowEdges_[(y & 1)*width];
+		const int* __restrict edges0 = &rowEdges_[((y + 1) & 1)*width];
+
+		for (int x = 0; x < width; ++x)
+			edges1[x] = edgeIndex(row[x], origin, invStep, top);
+
+		for (int x = 0; x < width; ++x)
+			++histogram[edges1[x]];
+
+		if (y == 0)
+			continue;
+
+		cellIntervals(edges0, edges1, cells, first, last, low, high);
+
+		// the second segment of saddles is added to the crossings after the sums
+		for (int i = 0; i < cells; ++i)
+		{
+			++active[first[i]];
+			--active[last[i]];
+			++segments[low[i]];
+			--segments[high[i]];
+		}
+	}
+
+	for (int k = 1; k <= bins_; ++k)
+	{
+		active_[k] += active_[k - 1];
+		segments_[k] += segments_[k - 1];
+	}
+
+	for (int k = 0; k <= bins_; ++k)
+		segments_[k] += active_[k];
+
+	active_.resize(bins_ + 1);
+	segments_.resize(bins_ + 1);
+}
+
+
+//
+int GridAnalysis::nearestEdge(const float value) const
+{
+	return static_cast<int>(std::lower_bound(edges_.begin(), edges_.end(), value) - edges_.begin());
+}
+
+
+//
+double GridAnalysis::interpolate(const std::vector<long long>& counts, const float threshold) const
+{
+	if (counts.empty() || threshold < minValue_ || threshold > edge(bins_))
+		return 0.0;
+
+	const int k = nearestEdge(threshold);
+
+	if (k > bins_)
+		return 0.0;
+
+	if (edge(k) == threshold || k == 0)
+		return static_cast<double>(counts[k]);
+
+	const double f = (threshold - edge(k - 1))/static_cast<double>(edge(k) - edge(k - 1));
+	return counts[k - 1]*(1.0 - f) + counts[k]*f;
+}
+
+
+//
+double GridAnalysis::activeCells(const float threshold) const
+{
+	return interpolate(active_, threshold);
+}
+
+
+//
+double GridAnalysis::predictSegments(const float threshold) const
+{
+	return interpolate(segments_, threshold);
+}
+
+
+//-----------------------------------------------------------------------------
+float GridAnalysis::quantile(const double q) const
+{
+	const double target = std::min(std::max(q, 0.0), 1.0)*samples_;
+	long long below = 0;
+	int k = 0;
+
+	// histogram_[k] counts the samples in (edge(k-1), edge(k)]
+	while (k < bins_ && below + histogram_[k] < target)
+		below += histogram_[k++];
+
+	return edge(k);
+}
+
+
+//
+std::vector<float> GridAnalysis::levels(const int count, const LevelSpacing spacing) const
+{
+	std::vector<float> result;
+
+	for (int i = 1; i <= count; ++i)
+	{
+		const double q = static_cast<double>(i)/(count + 1);
+
+		if (spacing == LEVELS_QUANTILE)
+			result.push_back(quantile(q));
+		else
+			result.push_back(edge(static_cast<int>(q*bins_ + 0.5)));
+	}
+
+	return result;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#ifndef GRIDANALYSIS_H_INCLUDED
+#define GRIDANALYSIS_H_INCLUDED
+
+#include "GridView.h"
+#include <vector>
+
+// Value statistics of a heightmap, gathered before any extraction.
+//
+// analyze() splits the value range into bins and makes one pass over the
+// samples (after a min/max pass unless the caller gives the range). Each
+// sample is mapped to an edge index with one clamped multiply; that mapping
+// is monotone, so a cell's [min, max) interval and its saddle interval are
+// integer min/max of its corners' indices. Edge k is then the largest value
+// the mapping sends to k or below, found once per edge, so a sample is above
+// edge(k) exactly when its index is above k. Difference arrays over the
+// intervals give, for every edge, the number of cells a threshold there
+// crosses and the segments they produce (saddles give two). At bin edges
+// the counts are exact, so automatic levels are snapped to edges and
+// output buffers can be sized before contouring.
+
+class GridAnalysis
+{
+public:
+
+	enum LevelSpacing
+	{
+		LEVELS_EQUAL_INTERVAL = 0,
+		LEVELS_QUANTILE			// same number of samples between consecutive levels
+	};
+
+	GridAnalysis();
+
+	void analyze(const GridView& view, const int bins = 1024);
+
+	// same, with the value range known (e.g. from the source format): no min/max pass
+	void analyze(const GridView& view, const int bins, const float minValue, const float maxValue);
+
+	inline int getBins() const { return bins_; };
+	inline float getMin() const { return minValue_; };
+	inline float getMax() const { return maxValue_; };
+	inline long long getSampleCount() const { return samples_; };
+	inline long long getCellCount() const { return cells_; };
+	inline float edge(const int k) const { return edges_[k]; };
+
+	// samples in (edge(k-1), edge(k)], k = 0..bins (k = 0: at or below edge(0))
+	inline const std::vector<long long>& getHistogram() const { return histogram_; };
+
+	// cells crossed / segments produced by a threshold: exact at bin
+	// edges, linearly interpolated in between
+	double activeCells(const float threshold) const;
+	double predictSegments(const float threshold) const;
+
+	// exact counts at edge(k)
+	inline long long activeCellsAt(const int k) const { return active_[k]; };
+	inline long long segmentsAt(const int k) const { return segments_[k]; };
+
+	// value below which a fraction q of the samples lie, snapped to a bin edge
+	float quantile(const double q) const;
+
+	// count interior levels (excluding the min and max), snapped to bin edges
+	std::vector<float> levels(const int count, const LevelSpacing spacing) const;
+
+protected:
+
+	// ceil((value - min)/step) clamped to [0, bins+1], monotone in value;
+	// no calls or branches, so loops over it vectorize (with the members
+	// passed in, they cannot alias the output)
+	static inline int edgeIndex(const float value, const float minValue, const float invStep, const float top)
+	{
+		float q = (value - minValue)*invStep;
+		q = (q > 0.0f) ? q : 0.0f;
+		q = (q < top) ? q : top;
+		return static_cast<int>(top) - static_cast<int>(top - q);
+	}
+
+	inline int edgeIndex(const float value) const { return edgeIndex(value, minValue_, invStep_, top_); };
+
+	// first edge k with edge(k) >= value; bins_+1 when value is above every edge
+	int nearestEdge(const float value) const;
+
+	double interpolate(const std::vector<long long>& counts, const float threshold) const;
+
+	int bins_;
+	float minValue_;
+	float maxValue_;
+	float step_;
+	float invStep_;
+	float top_;							// bins + 1
+	long long samples_;
+	long long cells_;
+	std::vector<long long> histogram_;
+	std::vector<long long> active_;		// per edge, bins+1 entries
+	std::vector<long long> segments_;
+	std::vector<float> edges_;			// bins+1 entries
+	std::vector<int> rowEdges_;			// analyze() scratch, edgeIndex of two rows
+};
+
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+#ifndef GRIDVIEW_H_INCLUDED
+#define GRIDVIEW_H_INCLUDED
+
+#include <cstddef>
+
+// Non-owning view of a rectangular region of a row-major heightmap.
+// base points to the first sample of the parent map, rows are rowStride
+// elements apart and the region starts at (originX, originY) in the parent,
+// so any sub-rectangle can be processed without copying.
+
+struct GridView
+{
+	GridView()
+		:base(NULL)
+		,width(0)
+		,height(0)
+		,rowStride(0)
+		,originX(0)
+		,originY(0)
+	{
+	}
+
+	GridView(const float* data, const int w, const int h, const int stride, const int x0 = 0, const int y0 = 0)
+		:base(data)
+		,width(w)
+		,height(h)
+		,rowStride(stride)
+		,originX(x0)
+		,originY(y0)
+	{
+	}
+
+	// tightly packed full map
+	static GridView whole(const float* data, const int w, const int h) { return GridView(data, w, h, w); }
+
+	inline bool empty() const { return base == NULL || width <= 0 || height <= 0; }
+
+	// row y of the region (region coordinates)
+	inline const float* row(const int y) const
+	{
+		return base + static_cast<std::ptrdiff_t>(originY + y)*rowStride + originX;
+	}
+
+	// sample at column x, row y (region coordinates)
+	inline float at(const int x, const int y) const { return row(y)[x]; }
+
+	// sub-rectangle relative to this region; origin stays in the parent frame
+	inline GridView subView(const int x, const int y, const int w, const int h) const
+	{
+		return GridView(base, w, h, rowStride, originX + x, originY + y);
+	}
+
+	const float* base;
+	int width;
+	int height;
+	int rowStride;
+	int originX;
+	int originY;
+};
+
+
+#endif
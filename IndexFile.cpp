@@ -0,0 +1,270 @@
+#include "IndexFile.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char INDEX_MAGIC[4] = { 'M', 'S', 'I', 'X' };
+static const uint32_t INDEX_VERSION = 1;
+static const uint64_t SECTION_ALIGNMENT = 64;
+
+struct IndexFileHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t kind;
+	uint32_t sectionCount;
+	uint64_t hash;
+	uint64_t parameters;
+};
+
+struct IndexSectionRecord
+{
+	uint32_t id;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+};
+
+
+//
+static inline uint64_t rotl64(const uint64_t v, const int r)
+{
+	return (v << r) | (v >> (64 - r));
+}
+
+
+//-----------------------------------------------------------------------------
+IndexFile::IndexFile()
+	:data_(NULL)
+	,size_(0)
+{
+}
+
+
+//
+IndexFile::~IndexFile()
+{
+	close();
+}
+
+
+//-----------------------------------------------------------------------------
+uint64_t IndexFile::contentHash(const GridView& view)
+{
+	static const uint64_t P1 = 0x9E3779B185EBCA87ull;
+	static const uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+
+	// four independent lanes over 8-byte words keep the multiplies pipelined
+	uint64_t lane[4] = { P1, P2, P1 ^ P2, ~P1 };
+	uint64_t tail = 0;
+
+	for (int y = 0; y < view.height; ++y)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(view.row(y));
+		const size_t size = static_cast<size_t>(view.width)*sizeof(float);
+		size_t pos = 0;
+
+		for (; pos + 32 <= size; pos += 32)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				uint64_t word;
+				memcpy(&word, bytes + pos + 8*k, sizeof(word));
+				lane[k] = rotl64(lane[k] + word*P2, 31)*P1;
+			}
+		}
+
+		for (; pos < size; ++pos)
+			tail = (tail ^ bytes[pos])*0x100000001B3ull;
+	}
+
+	uint64_t h = static_cast<uint64_t>(view.width) << 32 | static_cast<uint32_t>(view.height);
+
+	for (int k = 0; k < 4; ++k)
+		h = rotl64(h ^ (lane[k]*P2), 27)*P1 + 0x85EBCA77C2B2AE63ull;
+
+	h ^= tail*P2;
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+
+	return h;
+}
+
+
+//-----------------------------------------------------------------------------
+bool IndexFile::write(const std::string& filename, const uint32_t kind, const uint64_t hash,
+					  const uint64_t parameters, const std::vector<Section>& sections)
+{
+	IndexFileHeader header;
+	memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+	header.version = INDEX_VERSION;
+	header.kind = kind;
+	header.sectionCount = static_cast<uint32_t>(sections.size());
+	header.hash = hash;
+	header.parameters = parameters;
+
+	std::vector<IndexSectionRecord> records(sections.size());
+	uint64_t offset = sizeof(header) + records.size()*sizeof(IndexSectionRecord);
+
+	for (size_t k = 0; k < sections.size(); ++k)
+	{
+		offset = (offset + SECTION_ALIGNMENT - 1)/SECTION_ALIGNMENT*SECTION_ALIGNMENT;
+		records[k].id = sections[k].id;
+		records[k].reserved = 0;
+		records[k].offset = offset;
+		records[k].size = sections[k].size;
+		offset += sections[k].size;
+	}
+
+	// write to a temporary name so a concurrent reader never maps half a file
+	const std::string temporary = filename + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+
+	if (file == NULL)
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		   && (records.empty() || fwrite(&records[0], sizeof(IndexSectionRecord), records.size(), file) == records.size());
+
+	uint64_t position = sizeof(header) + records.size()*sizeof(IndexSectionRecord);
+	static const char padding[SECTION_ALIGNMENT] = { 0 };
+
+	for (size_t k = 0; ok && k < sections.size(); ++k)
+	{
+		ok = fwrite(padding, 1, records[k].offset - position, file) == records[k].offset - position
+		  && (sections[k].size == 0 || fwrite(sections[k].data, 1, sections[k].size, file) == sections[k].size);
+		position = records[k].offset + records[k].size;
+	}
+
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok)
+	{
+		remove(filename.c_str());
+		ok = rename(temporary.c_str(), filename.c_str()) == 0;
+	}
+
+	if (!ok)
+		remove(temporary.c_str());
+
+	return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+bool IndexFile::open(const std::string& filename, const uint32_t kind, const uint64_t hash, const uint64_t parameters)
+{
+	close();
+
+#ifdef _WIN32
+	FILE* file = fopen(filename.c_str(), "rb");
+
+	if (file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	buffer_.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+
+	const bool ok = !buffer_.empty() && fread(&buffer_[0], 1, buffer_.size(), file) == buffer_.size();
+	fclose(file);
+
+	if (!ok)
+	{
+		buffer_.clear();
+		return false;
+	}
+
+	data_ = &buffer_[0];
+	size_ = buffer_.size();
+#else
+	const int fd = ::open(filename.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(IndexFileHeader)))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (mapping == MAP_FAILED)
+		return false;
+
+	data_ = static_cast<const unsigned char*>(mapping);
+	size_ = info.st_size;
+#endif
+
+	const IndexFileHeader* header = reinterpret_cast<const IndexFileHeader*>(data_);
+
+	bool valid = size_ >= sizeof(IndexFileHeader)
+			  && memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0
+			  && header->version == INDEX_VERSION
+			  && header->kind == kind
+			  && header->hash == hash
+			  && header->parameters == parameters
+			  && size_ >= sizeof(IndexFileHeader) + header->sectionCount*sizeof(IndexSectionRecord);
+
+	for (uint32_t k = 0; valid && k < header->sectionCount; ++k)
+	{
+		const IndexSectionRecord& record = reinterpret_cast<const IndexSectionRecord*>(header + 1)[k];
+		valid = record.offset % SECTION_ALIGNMENT == 0 && record.offset <= size_ && record.size <= size_ - record.offset;
+	}
+
+	if (!valid)
+		close();
+
+	return valid;
+}
+
+
+//
+void IndexFile::close()
+{
+#ifndef _WIN32
+	if (data_ != NULL)
+		munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+
+	data_ = NULL;
+	size_ = 0;
+	buffer_.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+const void* IndexFile::section(const uint32_t id, uint64_t& size) const
+{
+	size = 0;
+
+	if (data_ == NULL)
+		return NULL;
+
+	const IndexFileHeader* header = reinterpret_cast<const IndexFileHeader*>(data_);
+	const IndexSectionRecord* records = reinterpret_cast<const IndexSectionRecord*>(header + 1);
+
+	for (uint32_t k = 0; k < header->sectionCount; ++k)
+	{
+		if (records[k].id == id)
+		{
+			size = records[k].size;
+			return data_ + records[k].offset;
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef INDEXFILE_H_INCLUDED
+#define INDEXFILE_H_INCLUDED
+
+#include "GridView.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Persisted acceleration structures.
+//
+// An index file holds the data a class derives from a heightmap (tile
+// bounds, pyramids, ...) as raw sections, tagged with a content hash of the
+// source grid and the parameters used to build them. Files are memory-mapped
+// read-only, so a restarted process uses the sections in place; a file whose
+// hash, kind or parameters do not match, or whose sections are not aligned
+// inside the file, is ignored and rebuilt by the caller. Section contents are
+// the caller's to validate.
+
+class IndexFile
+{
+public:
+
+	struct Section
+	{
+		Section() : id(0), data(NULL), size(0) {}
+		Section(const uint32_t i, const void* d, const uint64_t s) : id(i), data(d), size(s) {}
+
+		uint32_t id;
+		const void* data;
+		uint64_t size;		// bytes
+	};
+
+	IndexFile();
+	~IndexFile();
+
+	// hash of the samples and size of a view (not its position in memory)
+	static uint64_t contentHash(const GridView& view);
+
+	static bool write(const std::string& filename, const uint32_t kind, const uint64_t hash,
+					  const uint64_t parameters, const std::vector<Section>& sections);
+
+	bool open(const std::string& filename, const uint32_t kind, const uint64_t hash, const uint64_t parameters);
+	void close();
+
+	inline bool isOpen() const { return data_ != NULL; };
+
+	// section payload, NULL if missing; size in bytes
+	const void* section(const uint32_t id, uint64_t& size) const;
+
+protected:
+
+	IndexFile(const IndexFile&);
+	IndexFile& operator = (const IndexFile&);
+
+	const unsigned char* data_;
+	size_t size_;
+	std::vector<unsigned char> buffer_;		// platforms without mmap
+};
+
+
+#endif
@@ -0,0 +1,382 @@
+#include "IsolineCache.h"
+#include "IndexFile.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const char SPILL_MAGIC[4] = { 'M', 'S', 'R', 'C' };
+
+
+//-----------------------------------------------------------------------------
+void IsolineCacheStats::report(FILE* out) const
+{
+	const long long requests = hits + diskHits + misses;
+
+	fprintf(out, "cache: %lld requests, %lld hits, %lld disk hits, %lld misses (%.1f%% hit rate)\n",
+			requests, hits, diskHits, misses, requests ? 100.0*(hits + diskHits)/requests : 0.0);
+	fprintf(out, "       %lld entries, %.1f MB, %lld evictions, %lld spilled\n",
+			entries, bytes/1e6, evictions, spills);
+	fprintf(out, "       %lld on disk, %.1f MB, %lld disk evictions\n",
+			diskEntries, diskBytes/1e6, diskEvictions);
+}
+
+
+//-----------------------------------------------------------------------------
+bool IsolineCache::Key::operator < (const Key& other) const
+{
+	if (hash != other.hash) return hash < other.hash;
+	if (threshold != other.threshold) return threshold < other.threshold;
+	if (originX != other.originX) return originX < other.originX;
+	if (originY != other.originY) return originY < other.originY;
+	if (width != other.width) return width < other.width;
+	if (height != other.height) return height < other.height;
+	return options < other.options;
+}
+
+
+//
+bool IsolineCache::Key::operator == (const Key& other) const
+{
+	return hash == other.hash && threshold == other.threshold && originX == other.originX
+		&& originY == other.originY && width == other.width && height == other.height && options == other.options;
+}
+
+
+//-----------------------------------------------------------------------------
+IsolineCache::IsolineCache(const unsigned long long maxBytes, const unsigned long long maxDiskBytes)
+	:maxBytes_(maxBytes)
+	,maxDiskBytes_(maxDiskBytes)
+{
+}
+
+
+//
+IsolineCache::~IsolineCache()
+{
+	removeSpills();
+}
+
+
+//
+void IsolineCache::setSpillDirectory(const std::string& directory)
+{
+	// files in the old directory are not found any more
+	if (directory != spillDirectory_)
+		removeSpills();
+
+	spillDirectory_ = directory;
+}
+
+
+//
+void IsolineCache::setMaxBytes(const unsigned long long maxBytes)
+{
+	maxBytes_ = maxBytes;
+	evict();
+}
+
+
+//
+void IsolineCache::setMaxDiskBytes(const unsigned long long maxDiskBytes)
+{
+	maxDiskBytes_ = maxDiskBytes;
+	evictDisk();
+}
+
+
+//
+IsolineCache::Key IsolineCache::makeKey(const GridView& view, const float threshold, const uint32_t options)
+{
+	Key key;
+	key.hash = IndexFile::contentHash(view);
+	memcpy(&key.threshold, &threshold, sizeof(key.threshold));
+	key.originX = view.originX;
+	key.originY = view.originY;
+	key.width = view.width;
+	key.height = view.height;
+	key.options = options;
+	return key;
+}
+
+
+//
+uint32_t IsolineCache::extractionOptions(const MarchingSquares& marchingSquares)
+{
+	return static_cast<uint32_t>(marchingSquares.getTiling()) | (static_cast<uint32_t>(marchingSquares.getKernel()) << 8);
+}
+
+
+//-----------------------------------------------------------------------------
+const std::vector<float>* IsolineCache::find(const Key& key)
+{
+	std::map<Key, EntryList::iterator>::iterator it = index_.find(key);
+
+	if (it != index_.end())
+	{
+		// move to the front of the LRU list
+		entries_.splice(entries_.begin(), entries_, it->second);
+		++stats_.hits;
+		return &it->second->segments;
+	}
+
+	std::map<Key, SpillList::iterator>::iterator spilled = spillIndex_.find(key);
+
+	if (spilled == spillIndex_.end())
+		return NULL;
+
+	// back in memory: the file is not needed any more
+	const bool ok = unspill(*spilled->second, scratch_);
+	removeSpill(spilled);
+
+	if (!ok)
+		return NULL;
+
+	++stats_.diskHits;
+	return &insert(key, scratch_);
+}
+
+
+//
+const std::vector<float>& IsolineCache::insert(const Key& key, std::vector<float>& segments)
+{
+	std::map<Key, EntryList::iterator>::iterator it = index_.find(key);
+
+	if (it != index_.end())
+	{
+		stats_.bytes -= entryBytes(*it->second);
+		entries_.erase(it->second);
+		index_.erase(it);
+		--stats_.entries;
+	}
+
+	// a spilled copy would be stale
+	std::map<Key, SpillList::iterator>::iterator spilled = spillIndex_.find(key);
+
+	if (spilled != spillIndex_.end())
+		removeSpill(spilled);
+
+	entries_.push_front(Entry());
+	Entry& entry = entries_.front();
+	entry.key = key;
+	entry.segments.swap(segments);
+	segments.clear();
+
+	index_[key] = entries_.begin();
+	stats_.bytes += entryBytes(entry);
+	++stats_.entries;
+
+	evict();
+	return entry.segments;
+}
+
+
+//
+const std::vector<float>& IsolineCache::computeIsolines(MarchingSquares& marchingSquares, const float threshold)
+{
+	const GridView& view = marchingSquares.getGridView();
+	Key key = makeKey(view, threshold, extractionOptions(marchingSquares));
+
+	// the output frame is the one set on marchingSquares, not necessarily the view's
+	key.originX = static_cast<int32_t>(marchingSquares.getFrameX());
+	key.originY = static_cast<int32_t>(marchingSquares.getFrameY());
+
+	const std::vector<float>* cached = find(key);
+
+	if (cached != NULL)
+		return *cached;
+
+	++stats_.misses;
+
+	scratch_.clear();
+	SegmentBufferSink sink(scratch_);
+	marchingSquares.computeIsolines(threshold, sink);
+
+	return insert(key, scratch_);
+}
+
+
+//
+void IsolineCache::clear()
+{
+	entries_.clear();
+	index_.clear();
+	stats_.entries = 0;
+	stats_.bytes = 0;
+
+	removeSpills();
+}
+
+
+//-----------------------------------------------------------------------------
+unsigned long long IsolineCache::entryBytes(const Entry& entry)
+{
+	// payload plus the list node and the map node, roughly
+	return entry.segments.capacity()*sizeof(float) + sizeof(Entry) + sizeof(Key) + 64;
+}
+
+
+//
+void IsolineCache::evict()
+{
+	// the newest entry stays even when it alone exceeds the budget
+	while (stats_.bytes > maxBytes_ && entries_.size() > 1)
+	{
+		Entry& entry = entries_.back();
+
+		if (!spillDirectory_.empty() && spill(entry))
+		{
+			++stats_.spills;
+			evictDisk();
+		}
+
+		stats_.bytes -= entryBytes(entry);
+		index_.erase(entry.key);
+		entries_.pop_back();
+
+		--stats_.entries;
+		++stats_.evictions;
+	}
+}
+
+
+//
+void IsolineCache::evictDisk()
+{
+	while (stats_.diskBytes > maxDiskBytes_ && !spilled_.empty())
+	{
+		removeSpill(spillIndex_.find(spilled_.back().key));
+		++stats_.diskEvictions;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+std::string IsolineCache::spillPath(const Key& key) const
+{
+	char name[112];
+	snprintf(name, sizeof(name), "%016llx_%08x_%d_%d_%dx%d_%x.msc", static_cast<unsigned long long>(key.hash), key.threshold,
+			 key.originX, key.originY, key.width, key.height, key.options);
+
+	return spillDirectory_ + "/" + name;
+}
+
+
+//
+bool IsolineCache::spill(const Entry& entry)
+{
+	const std::string path = spillPath(entry.key);
+	const std::string temporary = path + ".tmp";
+
+	const uint64_t count = entry.segments.size();
+	const unsigned long long bytes = sizeof(SPILL_MAGIC) + sizeof(Key) + sizeof(count) + count*sizeof(float);
+
+	// a file that alone exceeds the disk budget would be deleted right away
+	if (bytes > maxDiskBytes_)
+		return false;
+
+	FILE* file = fopen(temporary.c_str(), "wb");
+
+	if (file == NULL)
+		return false;
+
+	bool ok = fwrite(SPILL_MAGIC, sizeof(SPILL_MAGIC), 1, file) == 1
+		   && fwrite(&entry.key, sizeof(Key), 1, file) == 1
+		   && fwrite(&count, sizeof(count), 1, file) == 1
+		   && (count == 0 || fwrite(&entry.segments[0], sizeof(float), count, file) == count);
+
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(temporary.c_str(), path.c_str()) == 0;
+	}
+
+	if (!ok)
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+
+	std::map<Key, SpillList::iterator>::iterator previous = spillIndex_.find(entry.key);
+
+	if (previous != spillIndex_.end())
+	{
+		stats_.diskBytes -= previous->second->bytes;
+		--stats_.diskEntries;
+		spilled_.erase(previous->second);
+		spillIndex_.erase(previous);
+	}
+
+	SpillFile spilled;
+	spilled.key = entry.key;
+	spilled.bytes = bytes;
+
+	spilled_.push_front(spilled);
+	spillIndex_[entry.key] = spilled_.begin();
+	stats_.diskBytes += bytes;
+	++stats_.diskEntries;
+
+	return true;
+}
+
+
+//
+bool IsolineCache::unspill(const SpillFile& spilled, std::vector<float>& segments)
+{
+	FILE* file = fopen(spillPath(spilled.key).c_str(), "rb");
+
+	if (file == NULL)
+		return false;
+
+	char magic[4];
+	Key stored;
+	uint64_t count = 0;
+	const unsigned long long header = sizeof(SPILL_MAGIC) + sizeof(Key) + sizeof(count);
+
+	bool ok = fread(magic, sizeof(magic), 1, file) == 1
+		   && memcmp(magic, SPILL_MAGIC, sizeof(magic)) == 0
+		   && fread(&stored, sizeof(Key), 1, file) == 1
+		   && stored == spilled.key
+		   && fread(&count, sizeof(count), 1, file) == 1
+		   && count % 4 == 0;
+
+	// the count must fit the size written and the file on disk before anything is allocated
+	ok = ok && spilled.bytes >= header && count == (spilled.bytes - header)/sizeof(float)
+		 && fseek(file, 0, SEEK_END) == 0 && static_cast<unsigned long long>(ftell(file)) == spilled.bytes
+		 && fseek(file, static_cast<long>(header), SEEK_SET) == 0;
+
+	if (ok)
+	{
+		segments.resize(count);
+		ok = count == 0 || fread(&segments[0], sizeof(float), count, file) == count;
+	}
+
+	fclose(file);
+
+	if (!ok)
+		segments.clear();
+
+	return ok;
+}
+
+
+//
+void IsolineCache::removeSpill(const std::map<Key, SpillList::iterator>::iterator& it)
+{
+	remove(spillPath(it->first).c_str());
+
+	stats_.diskBytes -= it->second->bytes;
+	--stats_.diskEntries;
+
+	spilled_.erase(it->second);
+	spillIndex_.erase(it);
+}
+
+
+//
+void IsolineCache::removeSpills()
+{
+	while (!spillIndex_.empty())
+		removeSpill(spillIndex_.begin());
+}
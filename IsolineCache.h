@@ -0,0 +1,131 @@
+#pragma once
+#ifndef ISOLINECACHE_H_INCLUDED
+#define ISOLINECACHE_H_INCLUDED
+
+#include "MarchingSquares.h"
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// Content-addressed cache of extraction results.
+//
+// Results are keyed by a hash of the grid samples plus the threshold, the
+// output frame and the extraction options that change the output order, so
+// the same region requested again (from any buffer) is answered without
+// touching the cells. Entries are kept in memory up to a byte budget with
+// least-recently-used eviction; with a spill directory, evicted entries go
+// to disk, up to a second budget with its own LRU order, and are read back
+// on a later hit. Spill files belong to the cache that wrote them (one
+// cache per directory): they are deleted when read back, when evicted from
+// disk, and by clear() and the destructor.
+
+struct IsolineCacheStats
+{
+	IsolineCacheStats() : hits(0), diskHits(0), misses(0), evictions(0), spills(0), diskEvictions(0), entries(0), bytes(0), diskEntries(0), diskBytes(0) {}
+
+	void report(FILE* out) const;
+
+	long long hits;			// served from memory
+	long long diskHits;		// served from the spill directory
+	long long misses;		// computed
+	long long evictions;
+	long long spills;		// evictions written to disk
+	long long diskEvictions;	// spill files deleted for the disk budget
+	long long entries;		// in memory
+	unsigned long long bytes;
+	long long diskEntries;	// in the spill directory
+	unsigned long long diskBytes;
+};
+
+class IsolineCache
+{
+public:
+
+	struct Key
+	{
+		Key() : hash(0), threshold(0), originX(0), originY(0), width(0), height(0), options(0) {}
+
+		bool operator < (const Key& other) const;
+		bool operator == (const Key& other) const;
+
+		uint64_t hash;		// IndexFile::contentHash of the samples
+		uint32_t threshold;	// bits of the float threshold
+		int32_t originX;	// output frame
+		int32_t originY;
+		int32_t width;
+		int32_t height;
+		uint32_t options;	// extractionOptions() of the producer, 0 for other sources
+	};
+
+	explicit IsolineCache(const unsigned long long maxBytes = 256ull << 20, const unsigned long long maxDiskBytes = 1ull << 30);
+	~IsolineCache();
+
+	// evicted entries are written to this directory (must exist); empty: discard
+	void setSpillDirectory(const std::string& directory);
+	void setMaxBytes(const unsigned long long maxBytes);
+	inline unsigned long long getMaxBytes() const { return maxBytes_; };
+	void setMaxDiskBytes(const unsigned long long maxDiskBytes);
+	inline unsigned long long getMaxDiskBytes() const { return maxDiskBytes_; };
+
+	static Key makeKey(const GridView& view, const float threshold, const uint32_t options = 0);
+
+	// tiling and kernel of marchingSquares, which decide the segment order
+	static uint32_t extractionOptions(const MarchingSquares& marchingSquares);
+
+	// cached segments, NULL on a miss; valid until the next insert()
+	const std::vector<float>* find(const Key& key);
+
+	// store a result, taking its segments (the argument is left empty)
+	const std::vector<float>& insert(const Key& key, std::vector<float>& segments);
+
+	// segments of marchingSquares' current view at threshold, computed only on a miss
+	const std::vector<float>& computeIsolines(MarchingSquares& marchingSquares, const float threshold);
+
+	void clear();
+	inline const IsolineCacheStats& getStats() const { return stats_; };
+
+protected:
+
+	struct Entry
+	{
+		Key key;
+		std::vector<float> segments;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	struct SpillFile
+	{
+		Key key;
+		unsigned long long bytes;
+	};
+
+	typedef std::list<SpillFile> SpillList;
+
+	static unsigned long long entryBytes(const Entry& entry);
+	std::string spillPath(const Key& key) const;
+	bool spill(const Entry& entry);
+	bool unspill(const SpillFile& spilled, std::vector<float>& segments);	// false on any mismatch: a miss
+	void removeSpill(const std::map<Key, SpillList::iterator>::iterator& it);
+	void removeSpills();
+	void evict();
+	void evictDisk();
+
+	IsolineCache(const IsolineCache&);
+	IsolineCache& operator = (const IsolineCache&);
+
+	unsigned long long maxBytes_;
+	unsigned long long maxDiskBytes_;
+	std::string spillDirectory_;
+	EntryList entries_;						// most recently used first
+	std::map<Key, EntryList::iterator> index_;
+	SpillList spilled_;						// most recently written first
+	std::map<Key, SpillList::iterator> spillIndex_;
+	std::vector<float> scratch_;
+	IsolineCacheStats stats_;
+};
+
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef ISOLINECURSOR_H_INCLUDED
+#define ISOLINECURSOR_H_INCLUDED
+
+#include "MarchingSquares.h"
+#include "PerfCounters.h"
+#include <algorithm>
+
+// Resumable isoline extraction.
+//
+// The cursor remembers the next step of a MarchingSquares extraction (a row
+// of cells, or a tile when tiled, see computeIsolineSteps()), so extraction
+// can be spread over several calls (e.g. one per frame), each bounded by a
+// number of cells and/or a time budget. Steps run through the extractor's
+// own tiling and kernel, so segments go to any segment sink exactly as
+// computeIsolines() would produce them, in the same order. The work runs on
+// the caller's thread on purpose: the viewer advances it from GLUT's idle(),
+// so progress is cooperative and the vertex list it fills needs no locking.
+
+class IsolineCursor
+{
+public:
+
+	IsolineCursor() : marchingSquares_(NULL), steps_(0), step_(0), cells_(0), threshold_(0.0f), processed_(0) {}
+
+	// the extractor must stay alive and keep its view until the cursor is done
+	void reset(MarchingSquares& marchingSquares, const float threshold)
+	{
+		const long long cellsX = std::max(marchingSquares.getWidth() - 1, 0);
+		const long long cellsY = std::max(marchingSquares.getHeight() - 1, 0);
+
+		marchingSquares_ = &marchingSquares;
+		steps_ = (cellsX > 0) ? marchingSquares.getIsolineSteps() : 0;
+		step_ = 0;
+		cells_ = cellsX*cellsY;
+		threshold_ = threshold;
+		processed_ = 0;
+	}
+
+	inline bool done() const { return step_ >= steps_; };
+	inline float getThreshold() const { return threshold_; };
+	inline long long getProcessedCells() const { return processed_; };
+	inline float progress() const { return (cells_ > 0 && !done()) ? float(processed_)/float(cells_) : 1.0f; };
+
+	// run steps until maxCells cells have been visited or maxSeconds have
+	// passed (0: no limit on that budget), at least one step per call;
+	// returns true once the whole view has been processed
+	template <class Sink>
+	bool advance(Sink& sink, const long long maxCells, const double maxSeconds = 0.0);
+
+protected:
+
+	MarchingSquares* marchingSquares_;
+	int steps_;
+	int step_;
+	long long cells_;
+	float threshold_;
+	long long processed_;
+};
+
+
+//-----------------------------------------------------------------------------
+template <class Sink>
+bool IsolineCursor::advance(Sink& sink, const long long maxCells, const double maxSeconds)
+{
+	const double deadline = (maxSeconds > 0.0) ? PerfCounters::now() + maxSeconds : 0.0;
+	long long visited = 0;
+
+	while (!done())
+	{
+		visited += marchingSquares_->computeIsolineSteps(threshold_, step_, step_ + 1, sink);
+		++step_;
+
+		if ((maxCells > 0 && visited >= maxCells) || (deadline > 0.0 && PerfCounters::now() >= deadline))
+			break;
+	}
+
+	processed_ += visited;
+	return done();
+}
+
+
+#endif
@@ -1,6 +1,8 @@
 #include "MarchingSquares.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
 
 MarchingSquares::MarchingSquares()
 	:width_(0)
@@ -9,48 +11,133 @@ MarchingSquares::MarchingSquares()
 	,xMax_(0)
 	,yMin_(0)
 	,yMax_(0)
-	,data_(NULL)
 	,threshold_(0.0f)
+	,grid_()
+	,profiling_(false)
+	,tiling_(TILING_NONE)
+	,tilesX_(0)
+	,tilesY_(0)
+	,tileCount_(0)
+	,tileMin_(NULL)
+	,tileMax_(NULL)
+	,tileOrder_(NULL)
+	,tileSamples_(NULL)
+	,kernel_(KERNEL_SCALAR)
 {
 }
 
 
+// same segments and end point order as cellSegments
+const signed char MarchingSquares::CASE_EDGES[16][4] =
+{
+	{ -1, -1, -1, -1 },	// 0
+	{  3,  0, -1, -1 },	// 1
+	{  3,  2, -1, -1 },	// 2
+	{  0,  2, -1, -1 },	// 3
+	{  2,  1, -1, -1 },	// 4
+	{  3,  0,  2,  1 },	// 5
+	{  3,  1, -1, -1 },	// 6
+	{  0,  1, -1, -1 },	// 7
+	{  0,  1, -1, -1 },	// 8
+	{  3,  1, -1, -1 },	// 9
+	{  3,  2,  0,  1 },	// 10
+	{  2,  1, -1, -1 },	// 11
+	{  0,  2, -1, -1 },	// 12
+	{  3,  2, -1, -1 },	// 13
+	{  3,  0, -1, -1 },	// 14
+	{ -1, -1, -1, -1 }	// 15
+};
+
+
 //
 MarchingSquares::~MarchingSquares()
 {
-	data_ = NULL; // do not delete data
+	grid_ = GridView(); // do not delete data
 }
 
 
 //
 void MarchingSquares::setHeightMap(const int width, const int height, float* data) 
 {
-	width_ = width; 
-	height_ = height; 
-	xMin_ = 0;  
-	xMax_ = width_;  
-	yMin_ = 0;  
-	yMax_ = height_;
-
-	/*
-	xMin_ = -width_/2;  
-	xMax_ = width_/2;  
-	yMin_ = -height_/2;  
-	yMax_ = height_/2;  
-	*/
-	data_ = data; 
+	setGridView(GridView::whole(data, width, height));
 };
 
 
+//
+void MarchingSquares::setData(float* data)
+{
+	GridView view = grid_;
+	view.base = data;
+	setGridView(view, xMin_, yMin_);
+}
+
+
+//
+void MarchingSquares::setGridView(const GridView& view)
+{
+	setGridView(view, view.originX, view.originY);
+}
+
+
+//
+void MarchingSquares::setGridView(const GridView& view, const int frameX, const int frameY)
+{
+	assignView(view, frameX, frameY);
+
+	if (tiling_ != TILING_NONE)
+		buildTiles();
+}
+
+
+//
+bool MarchingSquares::setGridView(const GridView& view, const std::string& indexFile)
+{
+	assignView(view, view.originX, view.originY);
+
+	if (tiling_ == TILING_NONE)
+		return false;
+
+	if (loadTiles(indexFile))
+		return true;
+
+	buildTiles();
+	saveTiles(indexFile);
+	return false;
+}
+
+
+//
+void MarchingSquares::assignView(const GridView& view, const int frameX, const int frameY)
+{
+	width_ = view.width; 
+	height_ = view.height; 
+
+	// one unit per sample, placed in the parent map's frame
+	xMin_ = frameX;  
+	xMax_ = frameX + width_ - 1;  
+	yMin_ = frameY;  
+	yMax_ = frameY + height_ - 1;
+
+	grid_ = view; 
+}
+
+
 //
 int MarchingSquares::evaluateCell(const float a, const float b, const float c, const float d)
+{
+	return classifyCell(a, b, c, d, threshold_);
+}
+
+
+//
+int MarchingSquares::classifyCell(const float a, const float b, const float c, const float d, const float threshold)
 {
 	int n = 0;
 	
-	if (a > threshold_) n+=1;
-	if (b > threshold_) n+=8;
-	if (c > threshold_) n+=4;
-	if (d > threshold_) n+=2;
+	if (a > threshold) n+=1;
+	if (b > threshold) n+=8;
+	if (c > threshold) n+=4;
+	if (d > threshold) n+=2;
 	
 	return n ;
 }
@@ -58,159 +145,162 @@ int MarchingSquares::evaluateCell(const float a, const float b, const float c, c
 
 // draw line segments for each case
 void MarchingSquares::lines(int num, int i,int j, float a, float b, float c, float d)
+{
+	const float dx=(xMax_-xMin_)/(width_-1.0f);
+	const float dy=(yMax_-yMin_)/(height_-1.0f);
+	const float ox=xMin_+i*dx;
+	const float oy=yMin_+j*dy;
+
+	float segments[8];
+	const int count = cellSegments(num, ox, oy, dx, dy, a, b, c, d, threshold_, segments);
+
+	for (int k = 0; k < 2*count; ++k)
+		isolineVertexList_.push_back(Vec2<float>(segments[2*k], segments[2*k+1]));
+}
+
+
+//
+int MarchingSquares::cellSegments(const int num,
+								  const float ox,
+								  const float oy,
+								  const float dx,
+								  const float dy,
+								  const float a,
+								  const float b,
+								  const float c,
+								  const float d,
+								  const float threshold,
+								  float* segments)
 {
 	switch(num) 
 	{
 		case 1 : case 2: case 4 : case 7: case 8: case 11: case 13: case 14:
-			draw_one(num,i,j,a,b,c,d);
-			break;
+			draw_one(num,ox,oy,dx,dy,a,b,c,d,threshold,segments);
+			return 1;
 	
 		case 3:  case 6:  case 9:  case 12:
-			draw_adjacent(num,i,j,a,b,c,d);
-			break;
+			draw_adjacent(num,ox,oy,dx,dy,a,b,c,d,threshold,segments);
+			return 1;
 	
 		case 5:  case 10:
-			draw_opposite(num,i,j,a,b,c,d);
-			break;
-	
-		case 0:  case 15:
-			break;
+			draw_opposite(num,ox,oy,dx,dy,a,b,c,d,threshold,segments);
+			return 2;
 	}
+
+	return 0;
 }
 
 
 //-----------------------------------------------------------------------------
 void MarchingSquares::draw_one( const int num,
-								const int i,
-								const int j,
+								const float ox,
+								const float oy,
+								const float dx,
+								const float dy,
 								const float a,
 								const float b,
 								const float c,
-								const float d)
+								const float d,
+								const float threshold,
+								float* s)
 {
-
-	const float dx=(xMax_-xMin_)/(width_-1.0f);
-	const float dy=(yMax_-yMin_)/(height_-1.0f);
-	const float ox=xMin_+i*(xMax_-xMin_)/(width_-1.0f);
-	const float oy=yMin_+j*(yMax_-yMin_)/(height_-1.0f);
-
-	float x1,y1,x2,y2;
-
 	switch(num) 
 	{
 		case 1 : case 14:
-			x1=ox;
-			y1=oy+dy*(threshold_-a)/(d-a);
-			x2=ox+dx*(threshold_-a)/(b-a);
-			y2=oy;
+			s[0]=ox;
+			s[1]=oy+dy*(threshold-a)/(d-a);
+			s[2]=ox+dx*(threshold-a)/(b-a);
+			s[3]=oy;
 			break;
 		case 2: case 13:
-			x1=ox;
-			y1=oy+dy*(threshold_-a)/(d-a);
-			x2=ox+dx*(threshold_-d)/(c-d);
-			y2=oy+dy;
+			s[0]=ox;
+			s[1]=oy+dy*(threshold-a)/(d-a);
+			s[2]=ox+dx*(threshold-d)/(c-d);
+			s[3]=oy+dy;
 			break;
 		case 4: case 11:
-			x1=ox+dx*(threshold_-d)/(c-d);
-			y1=oy+dy;
-			x2=ox+dx;
-			y2=oy+dy*(threshold_-b)/(c-b);
+			s[0]=ox+dx*(threshold-d)/(c-d);
+			s[1]=oy+dy;
+			s[2]=ox+dx;
+			s[3]=oy+dy*(threshold-b)/(c-b);
 			break;
 		case 7: case 8:
-			x1=ox+dx*(threshold_-a)/(b-a);
-			y1=oy;
-			x2=ox+dx;
-			y2=oy+dy*(threshold_-b)/(c-b);
+			s[0]=ox+dx*(threshold-a)/(b-a);
+			s[1]=oy;
+			s[2]=ox+dx;
+			s[3]=oy+dy*(threshold-b)/(c-b);
 			break;
 	}
-
-
-	isolineVertexList_.push_back(Vec2<float>(x1, y1));
-	isolineVertexList_.push_back(Vec2<float>(x2, y2));
 }
 
 
 //-----------------------------------------------------------------------------
 void MarchingSquares::draw_adjacent(const int num,
-									const int i,
-									const int j,
+									const float ox,
+									const float oy,
+									const float dx,
+									const float dy,
 									const float a,
 									const float b,
 									const float c,
-									const float d)
+									const float d,
+									const float threshold,
+									float* s)
 {
-	const float dx=(xMax_-xMin_)/(width_-1.0f);
-	const float dy=(yMax_-yMin_)/(height_-1.0f);
-	const float ox=xMin_+i*(xMax_-xMin_)/(width_-1.0f);
-	const float oy=yMin_+j*(yMax_-yMin_)/(height_-1.0f);
-	
-	float x1,y1,x2,y2;
-
 	switch(num) 
 	{
 	case 3 : case 12:
-		x1=ox+dx*(threshold_-a)/(b-a);
-		y1=oy;
-		x2=ox+dx*(threshold_-d)/(c-d);
-		y2=oy+dy;
+		s[0]=ox+dx*(threshold-a)/(b-a);
+		s[1]=oy;
+		s[2]=ox+dx*(threshold-d)/(c-d);
+		s[3]=oy+dy;
 		break;
 	case 6: case 9:
-		x1=ox;
-		y1=oy+dy*(threshold_-a)/(d-a);
-		x2=ox+dx;
-		y2=oy+dy*(threshold_-b)/(c-b);
+		s[0]=ox;
+		s[1]=oy+dy*(threshold-a)/(d-a);
+		s[2]=ox+dx;
+		s[3]=oy+dy*(threshold-b)/(c-b);
 		break;
 	}
-
-	isolineVertexList_.push_back(Vec2<float>(x1, y1));
-	isolineVertexList_.push_back(Vec2<float>(x2, y2));
-
 }
 
 
 //-----------------------------------------------------------------------------
 void MarchingSquares::draw_opposite(const int num,
-									const int i,
-									const int j,
+									const float ox,
+									const float oy,
+									const float dx,
+									const float dy,
 									const float a,
 									const float b,
 									const float c,
-									const float d)
+									const float d,
+									const float threshold,
+									float* s)
 {
-	const float dx=(xMax_-xMin_)/(width_-1.0f);
-	const float dy=(yMax_-yMin_)/(height_-1.0f);
-	const float ox=xMin_+i*(xMax_-xMin_)/(width_-1.0f);
-	const float oy=yMin_+j*(yMax_-yMin_)/(height_-1.0f);
-	float x1,y1,x2,y2,x3,y3,x4,y4;
-
 	switch(num) 
 	{
 		case 5 :
-			x1=ox;
-			y1=oy+dy*(threshold_-a)/(d-a);
-			x2=ox+dx*(threshold_-a)/(b-a);
-			y2=oy;
-			x3=ox+dx*(threshold_-d)/(c-d);
-			y3=oy+dy;
-			x4=ox+dx;
-			y4=oy+dy*(threshold_-b)/(c-b);
+			s[0]=ox;
+			s[1]=oy+dy*(threshold-a)/(d-a);
+			s[2]=ox+dx*(threshold-a)/(b-a);
+			s[3]=oy;
+			s[4]=ox+dx*(threshold-d)/(c-d);
+			s[5]=oy+dy;
+			s[6]=ox+dx;
+			s[7]=oy+dy*(threshold-b)/(c-b);
 			break;
 		case 10:
-			x1=ox;
-			y1=oy+dy*(threshold_-a)/(d-a);
-			x2=ox+dx*(threshold_-d)/(c-d);
-			y2=oy+dy;
-			x3=ox+dx*(threshold_-d)/(c-d);
-			y3=oy;
-			x4=ox+dx;
-			y4=oy+dy*(threshold_-b)/(c-b);		
+			s[0]=ox;
+			s[1]=oy+dy*(threshold-a)/(d-a);
+			s[2]=ox+dx*(threshold-d)/(c-d);
+			s[3]=oy+dy;
+			s[4]=ox+dx*(threshold-a)/(b-a);
+			s[5]=oy;
+			s[6]=ox+dx;
+			s[7]=oy+dy*(threshold-b)/(c-b);		
 			break;
 	}
-
-	isolineVertexList_.push_back(Vec2<float>(x1, y1));
-	isolineVertexList_.push_back(Vec2<float>(x2, y2));
-	isolineVertexList_.push_back(Vec2<float>(x3, y3));
-	isolineVertexList_.push_back(Vec2<float>(x4, y4));
 }
 
 
@@ -221,19 +311,363 @@ void MarchingSquares::computeIsolines(const float threshold)
 
 	isolineVertexList_.clear();
 
-	/* process each cell */
-	for (int i = 0; i < width_; ++i)
+	if (profiling_)
+	{
+		computeIsolinesProfiled();
+		return;
+	}
+
+	VertexListSink sink(isolineVertexList_);
+	computeIsolines(threshold, sink);
+}
+
+
+//-----------------------------------------------------------------------------
+void MarchingSquares::setTiling(const Tiling tiling)
+{
+	tiling_ = tiling;
+
+	indexFile_.close();
+	tileMinStorage_.clear();
+	tileMaxStorage_.clear();
+	tileOrderStorage_.clear();
+	tileSampleStorage_.clear();
+	tileCount_ = 0;
+
+	if (tiling_ != TILING_NONE && !grid_.empty())
+		buildTiles();
+}
+
+
+// interleave the bits of x and y
+static inline unsigned int mortonCode(const unsigned int x, const unsigned int y)
+{
+	unsigned int code = 0;
+
+	for (int bit = 0; bit < 16; ++bit)
+		code |= ((x >> bit) & 1u) << (2*bit) | ((y >> bit) & 1u) << (2*bit + 1);
+
+	return code;
+}
+
+
+//
+struct MortonLess
+{
+	MortonLess(const int tilesX) : tilesX_(tilesX) {}
+
+	inline bool operator () (const int lhs, const int rhs) const
 	{
-		for (int j = 0; j < height_; ++j)
+		return mortonCode(lhs % tilesX_, lhs / tilesX_) < mortonCode(rhs % tilesX_, rhs / tilesX_);
+	}
+
+	int tilesX_;
+};
+
+
+//-----------------------------------------------------------------------------
+void MarchingSquares::buildTiles()
+{
+	// tiles cover TILE_SIZE cells, i.e. TILE_SIZE+1 samples shared with the next tile
+	const int cellsX = std::max(width_ - 1, 0);
+	const int cellsY = std::max(height_ - 1, 0);
+	const int stride = TILE_SIZE + 1;
+
+	tilesX_ = (cellsX + TILE_SIZE - 1)/TILE_SIZE;
+	tilesY_ = (cellsY + TILE_SIZE - 1)/TILE_SIZE;
+
+	const int tileCount = tilesX_*tilesY_;
+
+	indexFile_.close();
+	tileMinStorage_.resize(tileCount);
+	tileMaxStorage_.resize(tileCount);
+	tileOrderStorage_.resize(tileCount);
+
+	for (int t = 0; t < tileCount; ++t)
+		tileOrderStorage_[t] = t;
+
+	if (tiling_ == TILING_MORTON)
+	{
+		std::sort(tileOrderStorage_.begin(), tileOrderStorage_.end(), MortonLess(tilesX_));
+		tileSampleStorage_.resize(static_cast<size_t>(tileCount)*stride*stride);
+	}
+	else
+		tileSampleStorage_.clear();
+
+	for (int k = 0; k < tileCount; ++k)
+	{
+		const int t = tileOrderStorage_[k];
+		const int x0 = (t % tilesX_)*TILE_SIZE;
+		const int y0 = (t / tilesX_)*TILE_SIZE;
+		const int w = std::min(stride, width_ - x0);
+		const int h = std::min(stride, height_ - y0);
+
+		float minValue = grid_.at(x0, y0);
+		float maxValue = minValue;
+
+		for (int y = 0; y < h; ++y)
+		{
+			const float* row = grid_.row(y0 + y) + x0;
+
+			for (int x = 0; x < w; ++x)
+			{
+				minValue = std::min(minValue, row[x]);
+				maxValue = std::max(maxValue, row[x]);
+			}
+
+			if (tiling_ == TILING_MORTON)
+				memcpy(&tileSampleStorage_[(static_cast<size_t>(k)*stride + y)*stride], row, w*sizeof(float));
+		}
+
+		tileMinStorage_[t] = minValue;
+		tileMaxStorage_[t] = maxValue;
+	}
+
+	tileCount_ = tileCount;
+	tileMin_ = tileCount ? &tileMinStorage_[0] : NULL;
+	tileMax_ = tileCount ? &tileMaxStorage_[0] : NULL;
+	tileOrder_ = tileCount ? &tileOrderStorage_[0] : NULL;
+	tileSamples_ = tileSampleStorage_.empty() ? NULL : &tileSampleStorage_[0];
+}
+
+
+// index file layout of the tiles
+static const uint32_t TILE_INDEX_KIND = 1;
+static const uint32_t SECTION_TILE_MIN = 1;
+static const uint32_t SECTION_TILE_MAX = 2;
+static const uint32_t SECTION_TILE_ORDER = 3;
+static const uint32_t SECTION_TILE_SAMPLES = 4;
+
+
+//
+static inline uint64_t tileIndexParameters(const MarchingSquares::Tiling tiling)
+{
+	return static_cast<uint64_t>(tiling) | static_cast<uint64_t>(MarchingSquares::TILE_SIZE) << 8;
+}
+
+
+//
+bool MarchingSquares::loadTiles(const std::string& indexFile)
+{
+	if (!indexFile_.open(indexFile, TILE_INDEX_KIND, IndexFile::contentHash(grid_), tileIndexParameters(tiling_)))
+		return false;
+
+	const int cellsX = std::max(width_ - 1, 0);
+	const int cellsY = std::max(height_ - 1, 0);
+	const int stride = TILE_SIZE + 1;
+	const int tilesX = (cellsX + TILE_SIZE - 1)/TILE_SIZE;
+	const int tilesY = (cellsY + TILE_SIZE - 1)/TILE_SIZE;
+	const uint64_t tileCount = static_cast<uint64_t>(tilesX)*tilesY;
+	const uint64_t sampleCount = (tiling_ == TILING_MORTON) ? tileCount*stride*stride : 0;
+
+	uint64_t minSize, maxSize, orderSize, sampleSize;
+	const void* minData = indexFile_.section(SECTION_TILE_MIN, minSize);
+	const void* maxData = indexFile_.section(SECTION_TILE_MAX, maxSize);
+	const void* orderData = indexFile_.section(SECTION_TILE_ORDER, orderSize);
+	const void* sampleData = indexFile_.section(SECTION_TILE_SAMPLES, sampleSize);
+
+	if (minSize != tileCount*sizeof(float) || maxSize != tileCount*sizeof(float)
+	 || orderSize != tileCount*sizeof(int) || sampleSize != sampleCount*sizeof(float))
+	{
+		indexFile_.close();
+		return false;
+	}
+
+	// the order indexes the other sections, so it must be a permutation of the tiles
+	const int* order = static_cast<const int*>(orderData);
+	std::vector<unsigned char> seen(static_cast<size_t>(tileCount), 0);
+
+	for (uint64_t k = 0; k < tileCount; ++k)
+	{
+		if (order[k] < 0 || static_cast<uint64_t>(order[k]) >= tileCount || seen[order[k]]++)
+		{
+			indexFile_.close();
+			return false;
+		}
+	}
+
+	tileMinStorage_.clear();
+	tileMaxStorage_.clear();
+	tileOrderStorage_.clear();
+	tileSampleStorage_.clear();
+
+	tilesX_ = tilesX;
+	tilesY_ = tilesY;
+	tileCount_ = static_cast<int>(tileCount);
+	tileMin_ = static_cast<const float*>(minData);
+	tileMax_ = static_cast<const float*>(maxData);
+	tileOrder_ = static_cast<const int*>(orderData);
+	tileSamples_ = sampleCount ? static_cast<const float*>(sampleData) : NULL;
+
+	return true;
+}
+
+
+//
+bool MarchingSquares::saveTiles(const std::string& indexFile) const
+{
+	const int stride = TILE_SIZE + 1;
+
+	std::vector<IndexFile::Section> sections;
+	sections.push_back(IndexFile::Section(SECTION_TILE_MIN, tileMin_, tileCount_*sizeof(float)));
+	sections.push_back(IndexFile::Section(SECTION_TILE_MAX, tileMax_, tileCount_*sizeof(float)));
+	sections.push_back(IndexFile::Section(SECTION_TILE_ORDER, tileOrder_, tileCount_*sizeof(int)));
+	sections.push_back(IndexFile::Section(SECTION_TILE_SAMPLES, tileSamples_,
+		(tileSamples_ != NULL) ? static_cast<uint64_t>(tileCount_)*stride*stride*sizeof(float) : 0));
+
+	return IndexFile::write(indexFile, TILE_INDEX_KIND, IndexFile::contentHash(grid_), tileIndexParameters(tiling_), sections);
+}
+
+
+//-----------------------------------------------------------------------------
+int MarchingSquares::compactRow(const float* row0, const float* row1, const int cells)
+{
+	if (static_cast<int>(rowCases_.size()) < cells)
+	{
+		rowCases_.resize(cells);
+		activeCells_.resize(cells);
+		activeCases_.resize(cells);
+		crossings_.resize(4*static_cast<size_t>(cells));
+	}
+
+	const float t = threshold_;
+	unsigned char* __restrict cases = rowCases_.data();
+
+	// phase 1: branch-free classification of the whole row, then compaction
+	for (int i = 0; i < cells; ++i)
+		cases[i] = static_cast<unsigned char>((row0[i] > t) | ((row1[i] > t) << 1) | ((row1[i+1] > t) << 2) | ((row0[i+1] > t) << 3));
+
+	int active = 0;
+
+	for (int i = 0; i < cells; ++i)
+	{
+		activeCells_[active] = i;
+		activeCases_[active] = cases[i];
+		active += (cases[i] != 0 && cases[i] != 15);
+	}
+
+	// phase 2: gather the corners of the active cells into separate arrays,
+	// then compute the crossing on all four edges in a loop the compiler
+	// turns into vector lerps; each array is overwritten with its edge
+	float* __restrict bottom = crossings_.data();
+	float* __restrict right = bottom + cells;
+	float* __restrict top = bottom + 2*static_cast<size_t>(cells);
+	float* __restrict left = bottom + 3*static_cast<size_t>(cells);
+
+	for (int k = 0; k < active; ++k)
+	{
+		const int i = activeCells_[k];
+		bottom[k] = row0[i];
+		right[k] = row0[i+1];
+		top[k] = row1[i+1];
+		left[k] = row1[i];
+	}
+
+	for (int k = 0; k < active; ++k)
+	{
+		const float a = bottom[k];
+		const float b = right[k];
+		const float c = top[k];
+		const float d = left[k];
+
+		bottom[k] = (t-a)/(b-a);
+		right[k] = (t-b)/(c-b);
+		top[k] = (t-d)/(c-d);
+		left[k] = (t-a)/(d-a);
+	}
+
+	return active;
+}
+
+
+//-----------------------------------------------------------------------------
+void MarchingSquares::setProfiling(const bool enabled)
+{
+	profiling_ = enabled;
+
+	if (enabled && !counters_.isOpen())
+		counters_.open();
+	else if (!enabled)
+		counters_.close();
+}
+
+
+//-----------------------------------------------------------------------------
+void MarchingSquares::computeIsolinesProfiled()
+{
+	const int cellsX = (width_ > 1) ? width_ - 1 : 0;
+	const int cellsY = (height_ > 1) ? height_ - 1 : 0;
+	const float dx=(xMax_-xMin_)/(width_-1.0f);
+	const float dy=(yMax_-yMin_)/(height_-1.0f);
+
+	profile_ = IsolineProfile();
+	profile_.cells = static_cast<long long>(cellsX)*cellsY;
+	profile_.countersAvailable = counters_.isOpen();
+
+	cellCases_.resize(profile_.cells);
+	segmentBuffer_.clear();
+
+	if (cellsX == 0 || cellsY == 0)
+		return;
+
+	// classification
+	counters_.start();
+
+	for (int j = 0; j < cellsY; ++j)
+	{
+		const float* row0 = grid_.row(j);
+		const float* row1 = grid_.row(j+1);
+		unsigned char* cases = cellCases_.data() + static_cast<std::ptrdiff_t>(j)*cellsX;
+
+		for (int i = 0; i < cellsX; ++i)
+			cases[i] = static_cast<unsigned char>(classifyCell(row0[i], row0[i+1], row1[i+1], row1[i], threshold_));
+	}
+
+	counters_.stop(profile_.classification);
+
+	// interpolation
+	counters_.start();
+
+	for (int j = 0; j < cellsY; ++j)
+	{
+		const float* row0 = grid_.row(j);
+		const float* row1 = grid_.row(j+1);
+		const unsigned char* cases = cellCases_.data() + static_cast<std::ptrdiff_t>(j)*cellsX;
+
+		for (int i = 0; i < cellsX; ++i)
 		{
-			const float a = data_[i*width_ + j];
-			const float b = data_[(i+1)*width_ + j];
-			const float c = data_[(i+1)*width_ + j+1];
-			const float d = data_[i*width_ + j+1];
-
-			lines(  evaluateCell(a, b, c, d), 
-					i, j, 
-					a, b, c, d );
+			if (cases[i] == 0 || cases[i] == 15)
+				continue;
+
+			float segments[8];
+			const int count = cellSegments(cases[i], xMin_+i*dx, yMin_+j*dy, dx, dy,
+										   row0[i], row0[i+1], row1[i+1], row1[i], threshold_, segments);
+
+			segmentBuffer_.insert(segmentBuffer_.end(), segments, segments + 4*count);
 		}
 	}
+
+	counters_.stop(profile_.interpolation);
+
+	// emission
+	counters_.start();
+
+	for (size_t k = 0; k < segmentBuffer_.size(); k += 2)
+		isolineVertexList_.push_back(Vec2<float>(segmentBuffer_[k], segmentBuffer_[k+1]));
+
+	counters_.stop(profile_.emission);
+
+	profile_.segments = static_cast<long long>(segmentBuffer_.size()/4);
+}
+
+
+//-----------------------------------------------------------------------------
+void IsolineProfile::report(FILE* out) const
+{
+	fprintf(out, "%lld cells, %lld segments, scalar untiled passes%s\n", cells, segments,
+			countersAvailable ? "" : " (hardware counters unavailable, time only)");
+
+	PerfCounters::report(out, "classification", classification, cells, segments);
+	PerfCounters::report(out, "interpolation", interpolation, cells, segments);
+	PerfCounters::report(out, "emission", emission, cells, segments);
 }
\ No newline at end of file
@@ -3,31 +3,161 @@
 #define MARCHINGSQUARES_H_INCLUDED
 
 #include "Vec2.h"
+#include "GridView.h"
+#include "PerfCounters.h"
+#include "IndexFile.h"
+#include <cstddef>
 #include <list>
+#include <string>
+#include <vector>
 
 // Extract isolines from heightmaps
 
+// Segment sinks for MarchingSquares::computeIsolines(threshold, sink).
+// A sink is any class with
+//
+//   void segment(float x1, float y1, float x2, float y2, int cellX, int cellY, float level);
+//
+// called once per segment as cells are classified; cellX/cellY are in the
+// parent map's frame. Sinks are template parameters, so small ones inline
+// into the cell loop and nothing is stored unless the sink stores it.
+
+// the classic output: end points appended to a vertex list
+struct VertexListSink
+{
+	VertexListSink(std::list< Vec2<float> >& list) : vertexList(list) {}
+
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int, const int, const float)
+	{
+		vertexList.push_back(Vec2<float>(x1, y1));
+		vertexList.push_back(Vec2<float>(x2, y2));
+	}
+
+	std::list< Vec2<float> >& vertexList;
+};
+
+// packed end points, 4 floats (x1,y1,x2,y2) per segment
+struct SegmentBufferSink
+{
+	SegmentBufferSink(std::vector<float>& buffer) : segments(buffer) {}
+
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int, const int, const float)
+	{
+		segments.push_back(x1);
+		segments.push_back(y1);
+		segments.push_back(x2);
+		segments.push_back(y2);
+	}
+
+	std::vector<float>& segments;
+};
+
+// counts segments and sums their length
+struct SegmentCounter
+{
+	SegmentCounter() : segments(0), length(0.0) {}
+
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int, const int, const float)
+	{
+		++segments;
+		length += sqrtf((x2 - x1)*(x2 - x1) + (y2 - y1)*(y2 - y1));
+	}
+
+	long long segments;
+	double length;
+};
+
+// feeds every segment to two sinks, e.g. a vertex list and a SegmentIndex
+template <class First, class Second>
+struct SinkPair
+{
+	SinkPair(First& f, Second& s) : first(f), second(s) {}
+
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int cellX, const int cellY, const float level)
+	{
+		first.segment(x1, y1, x2, y2, cellX, cellY, level);
+		second.segment(x1, y1, x2, y2, cellX, cellY, level);
+	}
+
+	First& first;
+	Second& second;
+};
+
+// per-phase counters of a profiled computeIsolines() (scalar, untiled passes)
+struct IsolineProfile
+{
+	IsolineProfile() : cells(0), segments(0), countersAvailable(false) {}
+
+	void report(FILE* out) const;
+
+	PerfSample classification;
+	PerfSample interpolation;
+	PerfSample emission;
+	long long cells;
+	long long segments;
+	bool countersAvailable;
+};
+
 class MarchingSquares
 {
 public:
 
+	enum Tiling
+	{
+		TILING_NONE = 0,	// row by row over the view
+		TILING_BLOCKED,		// TILE_SIZE square blocks over the view, skipping blocks off the threshold
+		TILING_MORTON		// same, over an internal copy with tiles stored in Z-order
+	};
+
+	enum Kernel
+	{
+		KERNEL_SCALAR = 0,	// classify and interpolate cell by cell, fixed-size kernels for 256/512 tiles
+		KERNEL_COMPACT,		// per row: compact the active cells, then interpolate them in bulk
+		KERNEL_GENERIC		// KERNEL_SCALAR without the fixed-size kernels
+	};
+
+	// cells per tile side
+	static const int TILE_SIZE = 64;
+
+	// edges crossed by each case, as pairs (bottom 0, right 1, top 2, left 3), -1 unused
+	static const signed char CASE_EDGES[16][4];
+
 	MarchingSquares();
 	~MarchingSquares();
 
-	inline const float atDataIndex(const int i, const int j) const { return data_[i*width_ + j]; };
+	// i = row, j = column of the current view
+	inline const float atDataIndex(const int i, const int j) const { return grid_.at(j, i); };
 		
 	inline const int getWidth() const { return width_; };
 	inline const int getHeight() const { return height_; };
-	inline float* getData() { return data_; };
+	inline const float* getData() const { return grid_.base; };
+	inline const GridView& getGridView() const { return grid_; };
+	inline const int getFrameX() const { return xMin_; };
+	inline const int getFrameY() const { return yMin_; };
 	inline const float getThreshold() { return threshold_; };
 	inline std::list< Vec2<float> >* getIsolineVertexList() { return &isolineVertexList_; };
 
 	//inline void setWidth(const int width) { width_ = width; };
 	//inline void setHeight(const int height) { height_ = height; };
-	inline void setData(float* data) { data_ = data; };
+	void setData(float* data);	// same layout and frame, new samples: tiles are rebuilt
 	inline void setThreshold(const float threshold) { threshold_ = threshold; };
 	void setHeightMap(const int width, const int height, float* data);
 
+	// contour a (possibly strided) region of a larger map in place;
+	// output coordinates are in the parent map's frame
+	void setGridView(const GridView& view);
+
+	// same, with the output frame origin given explicitly (e.g. a chunk
+	// buffer whose samples live at (frameX, frameY) in the full map)
+	void setGridView(const GridView& view, const int frameX, const int frameY);
+
+	// same as setGridView(view), with the tile index persisted in indexFile:
+	// a file built from the same samples and tiling is memory-mapped instead
+	// of rebuilding the tiles, any other (or one whose tile order is not a
+	// permutation of the tiles) is rebuilt and overwritten.
+	// Returns true when the index was loaded from the file.
+	bool setGridView(const GridView& view, const std::string& indexFile);
+
 	void debugInfo() const;
 
 	void lines(int num, int i,int j, float a, float b, float c, float d);
@@ -35,23 +165,315 @@ public:
 
 	void computeIsolines(const float threshold);
 
+	// push every segment to a sink instead of the vertex list (see VertexListSink)
+	template <class Sink>
+	void computeIsolines(const float threshold, Sink& sink);
+
+	// the same extraction split into steps, to spread it over several calls:
+	// a step is a row of cells, or a tile in traversal order when tiled, and
+	// running [0, getIsolineSteps()) in pieces gives computeIsolines()'s output.
+	// The range is clamped to the steps; returns the number of cells covered.
+	inline int getIsolineSteps() const { return (tiling_ == TILING_NONE) ? ((height_ > 1) ? height_ - 1 : 0) : tileCount_; };
+	template <class Sink>
+	long long computeIsolineSteps(const float threshold, const int first, const int last, Sink& sink);
+
+	// profiling mode: computeIsolines() runs classification, interpolation
+	// and emission as separate passes, each wrapped in hardware counters.
+	// The passes walk the whole view row by row with the scalar cell code:
+	// tiling and kernel are not applied, so the profile measures only the
+	// scalar, untiled path (and segments come in row order)
+	void setProfiling(const bool enabled);
+	inline bool isProfiling() const { return profiling_; };
+	inline const IsolineProfile& getProfile() const { return profile_; };
+
+	// cache-blocked traversal; the per-tile min/max (and the Z-order copy)
+	// are built when the map is set
+	void setTiling(const Tiling tiling);
+	inline Tiling getTiling() const { return tiling_; };
+
+	inline void setKernel(const Kernel kernel) { kernel_ = kernel; };
+	inline Kernel getKernel() const { return kernel_; };
+
+	// contour a W x H sample tile of any sample type, with the sizes known at
+	// compile time; computeIsolines() uses it for 256/257/512/513 square views
+	template <int W, int H, class T, class Sink>
+	static void processTile(const T* samples, const int rowStride, const int originX, const int originY,
+							const float threshold, Sink& sink);
+
+	// case index of a cell: a = (x,y), b = (x+1,y), c = (x+1,y+1), d = (x,y+1)
+	static int classifyCell(const float a, const float b, const float c, const float d, const float threshold);
+
+	// segments (x1,y1,x2,y2) of a cell with origin (ox,oy) and size (dx,dy);
+	// writes at most two segments and returns their count
+	static int cellSegments(const int num, const float ox, const float oy, const float dx, const float dy,
+							const float a, const float b, const float c, const float d, const float threshold, float* segments);
+
 protected:
 
-	void draw_one(const int num, const int i , const int j, const float a, const float b, const float c, const float d);
-	void draw_adjacent(const int num, const int i,const int j, const float a, const float b, const float c, const float d);
-	void draw_opposite(const int num, const int i,const int j, const float a, const float b, const float c, const float d);
+	static void draw_one(const int num, const float ox, const float oy, const float dx, const float dy, const float a, const float b, const float c, const float d, const float threshold, float* s);
+	static void draw_adjacent(const int num, const float ox, const float oy, const float dx, const float dy, const float a, const float b, const float c, const float d, const float threshold, float* s);
+	static void draw_opposite(const int num, const float ox, const float oy, const float dx, const float dy, const float a, const float b, const float c, const float d, const float threshold, float* s);
 
 	int width_;
 	int height_;
-	int xMax_;
 	int xMin_;
-	int yMax_;
+	int xMax_;
 	int yMin_;
+	int yMax_;
 	float threshold_;
-	float* data_;
+	GridView grid_;
 
 	std::list< Vec2<float> > isolineVertexList_;
+
+	void computeIsolinesProfiled();
+	template <class Sink>
+	void processCells(const GridView& view, const int i0, const int j0, Sink& sink) const;
+	template <class Sink>
+	void processCellsCompact(const GridView& view, const int i0, const int j0, Sink& sink);
+	template <class Sink>
+	bool processCellsFixed(const GridView& view, const int i0, const int j0, Sink& sink) const;
+	int compactRow(const float* row0, const float* row1, const int cells);
+	void assignView(const GridView& view, const int frameX, const int frameY);
+	void buildTiles();
+	bool loadTiles(const std::string& indexFile);
+	bool saveTiles(const std::string& indexFile) const;
+
+	bool profiling_;
+	PerfCounters counters_;
+	IsolineProfile profile_;
+	std::vector<unsigned char> cellCases_;
+	std::vector<float> segmentBuffer_;
+
+	Tiling tiling_;
+	int tilesX_;
+	int tilesY_;
+	int tileCount_;
+	const float* tileMin_;				// per tile, row-major tile index
+	const float* tileMax_;
+	const int* tileOrder_;				// traversal order of the tiles
+	const float* tileSamples_;			// TILING_MORTON: (TILE_SIZE+1)^2 samples per tile, in traversal order
+	std::vector<float> tileMinStorage_;	// backing of the arrays above unless mapped from indexFile_
+	std::vector<float> tileMaxStorage_;
+	std::vector<int> tileOrderStorage_;
+	std::vector<float> tileSampleStorage_;
+	IndexFile indexFile_;
+
+	Kernel kernel_;
+	std::vector<unsigned char> rowCases_;	// KERNEL_COMPACT scratch, one row
+	std::vector<int> activeCells_;
+	std::vector<unsigned char> activeCases_;
+	std::vector<float> crossings_;			// 4 edge arrays of the active cells
 };
 
 
+//-----------------------------------------------------------------------------
+template <class Sink>
+void MarchingSquares::computeIsolines(const float threshold, Sink& sink)
+{
+	computeIsolineSteps(threshold, 0, getIsolineSteps(), sink);
+}
+
+
+//
+template <class Sink>
+long long MarchingSquares::computeIsolineSteps(const float threshold, const int firstStep, const int lastStep, Sink& sink)
+{
+	threshold_ = threshold;
+
+	const int steps = getIsolineSteps();
+	const int first = (firstStep > 0) ? ((firstStep < steps) ? firstStep : steps) : 0;
+	const int last = (lastStep > 0) ? ((lastStep < steps) ? lastStep : steps) : 0;
+
+	if (first >= last)
+		return 0;
+
+	const int cellsX = (width_ > 1) ? width_ - 1 : 0;
+
+	if (tiling_ == TILING_NONE)
+	{
+		// the fixed-size kernels only take the whole view; their output is
+		// the same as processCells' on any row range
+		const GridView rows = grid_.subView(0, first, width_, last - first + 1);
+
+		if (kernel_ == KERNEL_COMPACT)
+			processCellsCompact(rows, 0, first, sink);
+		else if (kernel_ == KERNEL_GENERIC || rows.height != height_ || !processCellsFixed(rows, 0, 0, sink))
+			processCells(rows, 0, first, sink);
+
+		return static_cast<long long>(last - first)*cellsX;
+	}
+
+	const int stride = TILE_SIZE + 1;
+	long long cells = 0;
+
+	for (int k = first; k < last; ++k)
+	{
+		const int t = tileOrder_[k];
+		const int x0 = (t % tilesX_)*TILE_SIZE;
+		const int y0 = (t / tilesX_)*TILE_SIZE;
+		const int w = (stride < width_ - x0) ? stride : width_ - x0;
+		const int h = (stride < height_ - y0) ? stride : height_ - y0;
+
+		cells += static_cast<long long>(w - 1)*(h - 1);
+
+		// same test as classifyCell: no corner above or none below
+		if (!(tileMax_[t] > threshold_ && tileMin_[t] <= threshold_))
+			continue;
+
+		const GridView tile = (tiling_ == TILING_MORTON)
+			? GridView(tileSamples_ + static_cast<size_t>(k)*stride*stride, w, h, stride)
+			: grid_.subView(x0, y0, w, h);
+
+		if (kernel_ == KERNEL_COMPACT)
+			processCellsCompact(tile, x0, y0, sink);
+		else
+			processCells(tile, x0, y0, sink);
+	}
+
+	return cells;
+}
+
+
+//
+template <class Sink>
+void MarchingSquares::processCells(const GridView& view, const int i0, const int j0, Sink& sink) const
+{
+	const float dx=(xMax_-xMin_)/(width_-1.0f);
+	const float dy=(yMax_-yMin_)/(height_-1.0f);
+
+	/* process each cell: i = column, j = row */
+	for (int j = 0; j < view.height - 1; ++j)
+	{
+		const float* row0 = view.row(j);
+		const float* row1 = view.row(j+1);
+
+		for (int i = 0; i < view.width - 1; ++i)
+		{
+			const float a = row0[i];
+			const float b = row0[i+1];
+			const float c = row1[i+1];
+			const float d = row1[i];
+
+			const int num = classifyCell(a, b, c, d, threshold_);
+
+			if (num == 0 || num == 15)
+				continue;
+
+			float s[8];
+			const int count = cellSegments(num, xMin_+(i0+i)*dx, yMin_+(j0+j)*dy, dx, dy, a, b, c, d, threshold_, s);
+
+			for (int k = 0; k < count; ++k)
+				sink.segment(s[4*k], s[4*k+1], s[4*k+2], s[4*k+3], xMin_+i0+i, yMin_+j0+j, threshold_);
+		}
+	}
+}
+
+
+//
+template <class Sink>
+bool MarchingSquares::processCellsFixed(const GridView& view, const int i0, const int j0, Sink& sink) const
+{
+	if (view.width != view.height)
+		return false;
+
+	const float* samples = view.row(0);
+	const int ox = xMin_ + i0;
+	const int oy = yMin_ + j0;
+
+	switch (view.width)
+	{
+	case 256: processTile<256, 256>(samples, view.rowStride, ox, oy, threshold_, sink); return true;
+	case 257: processTile<257, 257>(samples, view.rowStride, ox, oy, threshold_, sink); return true;
+	case 512: processTile<512, 512>(samples, view.rowStride, ox, oy, threshold_, sink); return true;
+	case 513: processTile<513, 513>(samples, view.rowStride, ox, oy, threshold_, sink); return true;
+	default:  return false;
+	}
+}
+
+
+//
+template <int W, int H, class T, class Sink>
+void MarchingSquares::processTile(const T* samples, const int rowStride, const int originX, const int originY,
+								  const float threshold, Sink& sink)
+{
+	unsigned char cases[W - 1];
+
+	for (int j = 0; j < H - 1; ++j)
+	{
+		const T* __restrict row0 = samples + static_cast<ptrdiff_t>(j)*rowStride;
+		const T* __restrict row1 = row0 + rowStride;
+
+		// constant trip count and no branches: the classification vectorizes
+		for (int i = 0; i < W - 1; ++i)
+		{
+			const float a = static_cast<float>(row0[i]);
+			const float b = static_cast<float>(row0[i+1]);
+			const float c = static_cast<float>(row1[i+1]);
+			const float d = static_cast<float>(row1[i]);
+
+			cases[i] = static_cast<unsigned char>((a > threshold) | (d > threshold) << 1 | (c > threshold) << 2 | (b > threshold) << 3);
+		}
+
+		const float oy = static_cast<float>(originY + j);
+
+		for (int i = 0; i < W - 1; ++i)
+		{
+			const int num = cases[i];
+
+			if (num == 0 || num == 15)
+				continue;
+
+			const float a = static_cast<float>(row0[i]);
+			const float b = static_cast<float>(row0[i+1]);
+			const float c = static_cast<float>(row1[i+1]);
+			const float d = static_cast<float>(row1[i]);
+
+			float s[8];
+			const int count = cellSegments(num, static_cast<float>(originX + i), oy, 1.0f, 1.0f, a, b, c, d, threshold, s);
+
+			for (int k = 0; k < count; ++k)
+				sink.segment(s[4*k], s[4*k+1], s[4*k+2], s[4*k+3], originX + i, originY + j, threshold);
+		}
+	}
+}
+
+
+//
+template <class Sink>
+void MarchingSquares::processCellsCompact(const GridView& view, const int i0, const int j0, Sink& sink)
+{
+	if (view.width < 2 || view.height < 2)
+		return;
+
+	const float dx=(xMax_-xMin_)/(width_-1.0f);
+	const float dy=(yMax_-yMin_)/(height_-1.0f);
+	const int cells = view.width - 1;
+
+	for (int j = 0; j < view.height - 1; ++j)
+	{
+		const int active = compactRow(view.row(j), view.row(j+1), cells);
+
+		if (active == 0)
+			continue;
+
+		const float oy = yMin_+(j0+j)*dy;
+		const float* crossing[4] = { crossings_.data(), crossings_.data() + cells, crossings_.data() + 2*cells, crossings_.data() + 3*cells };
+
+		for (int k = 0; k < active; ++k)
+		{
+			const int i = activeCells_[k];
+			const float ox = xMin_+(i0+i)*dx;
+			const signed char* edges = CASE_EDGES[activeCases_[k]];
+
+			// end point on each edge, same expressions as cellSegments
+			const float ex[4] = { ox+dx*crossing[0][k], ox+dx, ox+dx*crossing[2][k], ox };
+			const float ey[4] = { oy, oy+dy*crossing[1][k], oy+dy, oy+dy*crossing[3][k] };
+
+			for (int e = 0; e < 4 && edges[e] >= 0; e += 2)
+				sink.segment(ex[edges[e]], ey[edges[e]], ex[edges[e+1]], ey[edges[e+1]], xMin_+i0+i, yMin_+j0+j, threshold_);
+		}
+	}
+}
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "MarchingSquaresC.h"
+#include "MarchingSquares.h"
+
+
+//
+static bool validGrid(const ms_grid_view* grid, const float* thresholds, const int32_t threshold_count)
+{
+	return grid != NULL && grid->data != NULL
+		&& grid->width >= 0 && grid->height >= 0 && grid->row_stride >= grid->width
+		&& (thresholds != NULL || threshold_count == 0) && threshold_count >= 0;
+}
+
+
+// a cursor left by a previous call with the same grid and thresholds
+static bool validCursor(const ms_cursor* cursor, const ms_grid_view* grid, const int32_t threshold_count)
+{
+	return cursor->level >= 0 && cursor->level <= threshold_count
+		&& cursor->cell_y >= 0 && cursor->cell_y <= ((grid->height > 1) ? grid->height - 1 : 0)
+		&& cursor->cell_x >= 0 && cursor->cell_x <= ((grid->width > 1) ? grid->width - 1 : 0)
+		&& cursor->emitted >= 0 && cursor->emitted <= 2;
+}
+
+
+//
+static GridView toGridView(const ms_grid_view* grid)
+{
+	return GridView(grid->data, grid->width, grid->height, grid->row_stride, grid->origin_x, grid->origin_y);
+}
+
+
+//-----------------------------------------------------------------------------
+int ms_abi_version(void)
+{
+	return MS_ABI_VERSION;
+}
+
+
+//
+void ms_cursor_reset(ms_cursor* cursor)
+{
+	if (cursor == NULL)
+		return;
+
+	cursor->level = 0;
+	cursor->cell_x = 0;
+	cursor->cell_y = 0;
+	cursor->emitted = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+int ms_count_segments(const ms_grid_view* grid, const float* thresholds, int32_t threshold_count, size_t* count)
+{
+	if (!validGrid(grid, thresholds, threshold_count) || count == NULL)
+		return MS_EINVAL;
+
+	const GridView view = toGridView(grid);
+	size_t total = 0;
+
+	for (int32_t level = 0; level < threshold_count; ++level)
+	{
+		for (int y = 0; y < view.height - 1; ++y)
+		{
+			const float* row0 = view.row(y);
+			const float* row1 = view.row(y+1);
+
+			for (int x = 0; x < view.width - 1; ++x)
+			{
+				const int num = MarchingSquares::classifyCell(row0[x], row0[x+1], row1[x+1], row1[x], thresholds[level]);
+
+				// saddles give two segments, the trivial cases none
+				total += (num == 5 || num == 10) ? 2 : (num != 0 && num != 15);
+			}
+		}
+	}
+
+	*count = total;
+	return MS_OK;
+}
+
+
+//-----------------------------------------------------------------------------
+int ms_extract_segments(const ms_grid_view* grid, const float* thresholds, int32_t threshold_count,
+						ms_segment* out, size_t capacity, ms_cursor* cursor, size_t* written)
+{
+	if (!validGrid(grid, thresholds, threshold_count) || cursor == NULL || written == NULL
+		|| (out == NULL && capacity > 0) || !validCursor(cursor, grid, threshold_count))
+		return MS_EINVAL;
+
+	const GridView view = toGridView(grid);
+	size_t n = 0;
+
+	for (; cursor->level < threshold_count; ++cursor->level, cursor->cell_y = 0)
+	{
+		const float threshold = thresholds[cursor->level];
+
+		for (; cursor->cell_y < view.height - 1; ++cursor->cell_y, cursor->cell_x = 0)
+		{
+			const int y = cursor->cell_y;
+			const float* row0 = view.row(y);
+			const float* row1 = view.row(y+1);
+
+			for (; cursor->cell_x < view.width - 1; ++cursor->cell_x, cursor->emitted = 0)
+			{
+				const int x = cursor->cell_x;
+				const float a = row0[x];
+				const float b = row0[x+1];
+				const float c = row1[x+1];
+				const float d = row1[x];
+
+				float segments[8];
+				const int count = MarchingSquares::cellSegments(MarchingSquares::classifyCell(a, b, c, d, threshold),
+																static_cast<float>(view.originX + x),
+																static_cast<float>(view.originY + y),
+																1.0f, 1.0f, a, b, c, d, threshold, segments);
+
+				for (; cursor->emitted < count; ++cursor->emitted)
+				{
+					if (n == capacity)
+					{
+						*written = n;
+						return MS_MORE;
+					}
+
+					const float* s = segments + 4*cursor->emitted;
+					out[n].x1 = s[0];
+					out[n].y1 = s[1];
+					out[n].x2 = s[2];
+					out[n].y2 = s[3];
+					out[n].level = cursor->level;
+					++n;
+				}
+			}
+		}
+	}
+
+	*written = n;
+	return MS_OK;
+}
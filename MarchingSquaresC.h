@@ -0,0 +1,76 @@
+#ifndef MARCHINGSQUARESC_H_INCLUDED
+#define MARCHINGSQUARESC_H_INCLUDED
+
+/*
+ * Stable C interface for isoline extraction.
+ *
+ * The library never allocates: the caller describes its grid with an
+ * ms_grid_view and receives segments in its own ms_segment buffer, either
+ * sized beforehand with ms_count_segments() or filled in several calls with
+ * a resumable ms_cursor. ms_segment is exchanged as arrays, so no
+ * structure can change, not even by growing at the end, without a new
+ * MS_ABI_VERSION; check ms_abi_version() against it.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MS_ABI_VERSION 1
+
+#define MS_OK      0	/* all segments written */
+#define MS_MORE    1	/* buffer full, call again with the same cursor */
+#define MS_EINVAL -1	/* invalid argument */
+
+/* row-major float grid; (origin_x, origin_y) offsets both the first sample
+   read and the output coordinates, row_stride is in elements */
+typedef struct ms_grid_view
+{
+	const float* data;
+	int32_t width;
+	int32_t height;
+	int32_t row_stride;
+	int32_t origin_x;
+	int32_t origin_y;
+} ms_grid_view;
+
+typedef struct ms_segment
+{
+	float x1;
+	float y1;
+	float x2;
+	float y2;
+	int32_t level;		/* index into the thresholds array */
+} ms_segment;
+
+/* resume point of an extraction; zero it (or call ms_cursor_reset) before
+   the first call. A cursor outside the grid and thresholds it is used
+   with gives MS_EINVAL. */
+typedef struct ms_cursor
+{
+	int32_t level;
+	int32_t cell_x;
+	int32_t cell_y;
+	int32_t emitted;	/* segments of the current cell already written */
+} ms_cursor;
+
+int ms_abi_version(void);
+
+void ms_cursor_reset(ms_cursor* cursor);
+
+/* number of segments all thresholds produce, for sizing the output */
+int ms_count_segments(const ms_grid_view* grid, const float* thresholds, int32_t threshold_count, size_t* count);
+
+/* write up to capacity segments; returns MS_MORE when the buffer filled up
+   before the end, MS_OK once everything has been written */
+int ms_extract_segments(const ms_grid_view* grid, const float* thresholds, int32_t threshold_count,
+						ms_segment* out, size_t capacity, ms_cursor* cursor, size_t* written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+#include "PerfCounters.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#endif
+
+
+//-----------------------------------------------------------------------------
+double PerfCounters::now()
+{
+#ifdef __linux__
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+#else
+	// wall clock; clock() would be process CPU time on POSIX
+	const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast< std::chrono::duration<double> >(elapsed).count();
+#endif
+}
+
+
+#ifdef __linux__
+//
+static int openCounter(const uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;	// allowed with perf_event_paranoid <= 2
+	attr.exclude_hv = 1;
+
+	return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+
+//-----------------------------------------------------------------------------
+PerfSample::PerfSample()
+	:seconds(0.0)
+{
+	for (int k = 0; k < COUNTER_COUNT; ++k)
+	{
+		value[k] = 0;
+		valid[k] = false;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+PerfCounters::PerfCounters()
+	:beginTime_(0.0)
+	,opened_(false)
+{
+	for (int k = 0; k < PerfSample::COUNTER_COUNT; ++k)
+		fd_[k] = -1;
+}
+
+
+//
+PerfCounters::~PerfCounters()
+{
+	close();
+}
+
+
+//-----------------------------------------------------------------------------
+bool PerfCounters::open()
+{
+	close();
+
+#ifdef __linux__
+	static const uint64_t configs[PerfSample::COUNTER_COUNT] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	// counters are opened one by one so a missing event only drops itself
+	for (int k = 0; k < PerfSample::COUNTER_COUNT; ++k)
+	{
+		fd_[k] = openCounter(configs[k]);
+		opened_ = opened_ || fd_[k] >= 0;
+	}
+#endif
+
+	return opened_;
+}
+
+
+//
+void PerfCounters::close()
+{
+	for (int k = 0; k < PerfSample::COUNTER_COUNT; ++k)
+	{
+#ifdef __linux__
+		if (fd_[k] >= 0)
+			::close(fd_[k]);
+#endif
+		fd_[k] = -1;
+	}
+
+	opened_ = false;
+}
+
+
+//-----------------------------------------------------------------------------
+void PerfCounters::start()
+{
+#ifdef __linux__
+	for (int k = 0; k < PerfSample::COUNTER_COUNT; ++k)
+	{
+		if (fd_[k] < 0)
+			continue;
+
+		ioctl(fd_[k], PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd_[k], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+
+	beginTime_ = now();
+}
+
+
+//
+void PerfCounters::stop(PerfSample& sample)
+{
+	sample.seconds = now() - beginTime_;
+
+	for (int k = 0; k < PerfSample::COUNTER_COUNT; ++k)
+	{
+		sample.value[k] = 0;
+		sample.valid[k] = false;
+
+#ifdef __linux__
+		uint64_t value = 0;
+
+		if (fd_[k] < 0)
+			continue;
+
+		ioctl(fd_[k], PERF_EVENT_IOC_DISABLE, 0);
+
+		if (read(fd_[k], &value, sizeof(value)) == sizeof(value))
+		{
+			sample.value[k] = value;
+			sample.valid[k] = true;
+		}
+#endif
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+void PerfCounters::report(FILE* out, const char* phase, const PerfSample& sample, const long long cells, const long long segments)
+{
+	static const char* names[PerfSample::COUNTER_COUNT] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+
+	fprintf(out, "%-14s %10.3f ms", phase, sample.seconds*1e3);
+
+	if (cells > 0)
+		fprintf(out, "  %8.2f ns/cell", sample.seconds*1e9/cells);
+
+	for (int k = 0; k < PerfSample::COUNTER_COUNT; ++k)
+	{
+		if (!sample.valid[k])
+			continue;
+
+		fprintf(out, "  %s %.3f/cell", names[k], cells > 0 ? double(sample.value[k])/cells : 0.0);
+
+		if (segments > 0)
+			fprintf(out, " %.3f/seg", double(sample.value[k])/segments);
+	}
+
+	if (sample.valid[PerfSample::CYCLES] && sample.valid[PerfSample::INSTRUCTIONS])
+		fprintf(out, "  IPC %.2f", sample.ipc());
+
+	fprintf(out, "\n");
+}
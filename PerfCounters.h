@@ -0,0 +1,66 @@
+#pragma once
+#ifndef PERFCOUNTERS_H_INCLUDED
+#define PERFCOUNTERS_H_INCLUDED
+
+#include <stdint.h>
+#include <cstdio>
+
+// Hardware counters around a region of code (Linux perf_event_open).
+//
+// When the counters are not available (other platforms, containers,
+// perf_event_paranoid too strict) open() returns false and samples only
+// carry the wall-clock time, so callers can profile unconditionally.
+
+struct PerfSample
+{
+	enum Counter
+	{
+		CYCLES = 0,
+		INSTRUCTIONS,
+		CACHE_MISSES,
+		BRANCH_MISSES,
+		COUNTER_COUNT
+	};
+
+	PerfSample();
+
+	inline double ipc() const { return value[CYCLES] ? double(value[INSTRUCTIONS])/value[CYCLES] : 0.0; };
+
+	uint64_t value[COUNTER_COUNT];
+	bool valid[COUNTER_COUNT];
+	double seconds;
+};
+
+class PerfCounters
+{
+public:
+
+	PerfCounters();
+	~PerfCounters();
+
+	bool open();
+	void close();
+
+	inline bool isOpen() const { return opened_; };
+
+	void start();
+	void stop(PerfSample& sample);
+
+	// monotonic wall-clock time in seconds
+	static double now();
+
+	// one line per sample, counters divided by cells and segments
+	static void report(FILE* out, const char* phase, const PerfSample& sample, const long long cells, const long long segments);
+
+protected:
+
+	PerfCounters(const PerfCounters&);
+	PerfCounters& operator = (const PerfCounters&);
+
+	int fd_[PerfSample::COUNTER_COUNT];
+	double beginTime_;
+	bool opened_;
+};
+
+
+#endif
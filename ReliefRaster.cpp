@@ -0,0 +1,193 @@
+#include "ReliefRaster.h"
+#include "IndexFile.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if __cplusplus >= 201103L
+#include <thread>
+#endif
+
+static const int NO_DATA = 256;
+
+//-----------------------------------------------------------------------------
+ReliefRaster::ReliefRaster()
+	:minValue_(0.0f)
+	,maxValue_(1.0f)
+	,colormap_(COLORMAP_TERRAIN)
+	,azimuth_(315.0f)
+	,altitude_(45.0f)
+	,zFactor_(1.0f)
+	,ambient_(0.35f)
+	,threads_(0)
+	,dirty_(true)
+	,hash_(0)
+	,width_(0)
+	,height_(0)
+	,generation_(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+bool ReliefRaster::update(const GridView& view)
+{
+	const uint64_t hash = IndexFile::contentHash(view);
+
+	if (!dirty_ && hash == hash_ && view.width == width_ && view.height == height_)
+		return false;
+
+	dirty_ = false;
+	hash_ = hash;
+	width_ = view.width;
+	height_ = view.height;
+	pixels_.resize(4*static_cast<size_t>(width_)*height_);
+
+	buildColormap();
+
+	if (view.empty())
+		return true;
+
+	int threads = threads_;
+
+#if __cplusplus >= 201103L
+	if (threads <= 0)
+		threads = static_cast<int>(std::thread::hardware_concurrency());
+#endif
+
+	threads = std::min(std::max(threads, 1), height_);
+
+#if __cplusplus >= 201103L
+	std::vector<std::thread> workers;
+
+	for (int t = 1; t < threads; ++t)
+		workers.push_back(std::thread(&ReliefRaster::renderRows, this, view,
+									  static_cast<int>(static_cast<long long>(height_)*t/threads),
+									  static_cast<int>(static_cast<long long>(height_)*(t + 1)/threads)));
+
+	renderRows(view, 0, height_/threads);
+
+	for (size_t t = 0; t < workers.size(); ++t)
+		workers[t].join();
+#else
+	renderRows(view, 0, height_);
+#endif
+
+	++generation_;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+void ReliefRaster::buildColormap()
+{
+	struct Stop { float t; float r, g, b; };
+
+	static const Stop gray[2] = { { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+	static const Stop terrain[6] =
+	{
+		{ 0.00f, 0.10f, 0.25f, 0.55f },
+		{ 0.20f, 0.25f, 0.55f, 0.80f },
+		{ 0.25f, 0.30f, 0.60f, 0.30f },
+		{ 0.55f, 0.75f, 0.75f, 0.40f },
+		{ 0.80f, 0.55f, 0.40f, 0.30f },
+		{ 1.00f, 0.97f, 0.97f, 0.97f }
+	};
+
+	const Stop* stops = (colormap_ == COLORMAP_GRAY) ? gray : terrain;
+	const int count = (colormap_ == COLORMAP_GRAY) ? 2 : 6;
+
+	for (int k = 0, s = 0; k < 256; ++k)
+	{
+		const float t = k/255.0f;
+
+		while (s < count - 2 && t > stops[s + 1].t)
+			++s;
+
+		const float f = (t - stops[s].t)/(stops[s + 1].t - stops[s].t);
+
+		lut_[k][0] = static_cast<unsigned char>(255.0f*(stops[s].r + (stops[s + 1].r - stops[s].r)*f) + 0.5f);
+		lut_[k][1] = static_cast<unsigned char>(255.0f*(stops[s].g + (stops[s + 1].g - stops[s].g)*f) + 0.5f);
+		lut_[k][2] = static_cast<unsigned char>(255.0f*(stops[s].b + (stops[s + 1].b - stops[s].b)*f) + 0.5f);
+		lut_[k][3] = 255;
+	}
+
+	lut_[NO_DATA][0] = lut_[NO_DATA][1] = lut_[NO_DATA][2] = lut_[NO_DATA][3] = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+void ReliefRaster::renderRows(const GridView& view, const int y0, const int y1)
+{
+	const int w = view.width;
+	const float degrees = 3.14159265f/180.0f;
+	const float lx = cosf(altitude_*degrees)*sinf(azimuth_*degrees);
+	const float ly = cosf(altitude_*degrees)*cosf(azimuth_*degrees);
+	const float lz = sinf(altitude_*degrees);
+	const float gradient = zFactor_/8.0f;
+	const float scale = (maxValue_ > minValue_) ? 255.0f/(maxValue_ - minValue_) : 0.0f;
+	const float offset = minValue_;
+	const float ambient = std::min(std::max(ambient_, 0.0f), 1.0f);
+
+	// three rows with the border sample repeated on both sides
+	std::vector<float> padded(3*static_cast<size_t>(w + 2));
+	std::vector<float> shade(w);
+	std::vector<float> normal(w);
+	std::vector<int> index(w);
+
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int r = 0; r < 3; ++r)
+		{
+			const float* source = view.row(std::min(std::max(y + r - 1, 0), view.height - 1));
+			float* row = &padded[r*static_cast<size_t>(w + 2)];
+
+			std::copy(source, source + w, row + 1);
+			row[0] = source[0];
+			row[w + 1] = source[w - 1];
+		}
+
+		// rows below (y-1), at and above (y+1) in the map's +y direction
+		const float* __restrict below = &padded[0];
+		const float* __restrict middle = &padded[w + 2];
+		const float* __restrict above = &padded[2*static_cast<size_t>(w + 2)];
+		float* __restrict facing = &shade[0];
+		float* __restrict length = &normal[0];
+		int* __restrict colour = &index[0];
+
+		// no calls in here (sqrtf may set errno), so the loop vectorizes
+		for (int x = 0; x < w; ++x)
+		{
+			const float dzdx = ((below[x+2] + 2.0f*middle[x+2] + above[x+2]) - (below[x] + 2.0f*middle[x] + above[x]))*gradient;
+			const float dzdy = ((above[x] + 2.0f*above[x+1] + above[x+2]) - (below[x] + 2.0f*below[x+1] + below[x+2]))*gradient;
+
+			// normal (-dzdx, -dzdy, 1) against the light, normalized below
+			facing[x] = lz - lx*dzdx - ly*dzdy;
+			length[x] = 1.0f + dzdx*dzdx + dzdy*dzdy;
+
+			// comparisons written so that NaN ends up on the clamped side
+			float v = (middle[x+1] - offset)*scale;
+			v = (v > 0.0f) ? v : 0.0f;
+			v = (v < 255.0f) ? v : 255.0f;
+			colour[x] = (middle[x+1] - middle[x+1] == 0.0f) ? static_cast<int>(v) : NO_DATA;
+		}
+
+		unsigned char* out = &pixels_[4*static_cast<size_t>(y)*w];
+
+		for (int x = 0; x < w; ++x)
+		{
+			// slopes next to a non-finite sample give NaN: ambient light only
+			float lambert = facing[x]/sqrtf(length[x]);
+			lambert = (lambert > 0.0f) ? lambert : 0.0f;
+			lambert = (lambert < 1.0f) ? lambert : 1.0f;
+
+			const float light = ambient + (1.0f - ambient)*lambert;
+			const unsigned char* rgba = lut_[colour[x]];
+
+			out[4*x]   = static_cast<unsigned char>(rgba[0]*light + 0.5f);
+			out[4*x+1] = static_cast<unsigned char>(rgba[1]*light + 0.5f);
+			out[4*x+2] = static_cast<unsigned char>(rgba[2]*light + 0.5f);
+			out[4*x+3] = rgba[3];
+		}
+	}
+}
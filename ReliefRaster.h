@@ -0,0 +1,81 @@
+#pragma once
+#ifndef RELIEFRASTER_H_INCLUDED
+#define RELIEFRASTER_H_INCLUDED
+
+#include "GridView.h"
+#include <stdint.h>
+#include <vector>
+
+// Colour-mapped, hillshaded RGBA image of a heightmap.
+//
+// update() renders one RGBA8 pixel per sample, row-major with row 0 first,
+// and does nothing when neither the samples (by content hash) nor the
+// settings changed since the last call, so the viewer can upload the image
+// once as a texture and headless tile rendering can reuse it. Rows are
+// split between threads; each row's slopes come from three edge-padded
+// rows in a branch-free loop the compiler vectorizes, then the row is lit
+// and coloured through a 256-entry lookup table. Slopes use Horn's 3x3 gradient, clamped at the
+// view border.
+
+class ReliefRaster
+{
+public:
+
+	enum Colormap
+	{
+		COLORMAP_GRAY = 0,
+		COLORMAP_TERRAIN		// water blue, lowland green, rock brown, snow white
+	};
+
+	ReliefRaster();
+
+	// heights mapped to the colormap (the viewer's images are in [0,1])
+	inline void setRange(const float minValue, const float maxValue) { minValue_ = minValue; maxValue_ = maxValue; dirty_ = true; };
+	inline void setColormap(const Colormap colormap) { colormap_ = colormap; dirty_ = true; };
+
+	// light direction in degrees, azimuth clockwise from +y
+	inline void setLight(const float azimuth, const float altitude) { azimuth_ = azimuth; altitude_ = altitude; dirty_ = true; };
+
+	// height units per sample spacing, and the light reaching fully shadowed slopes
+	inline void setZFactor(const float zFactor) { zFactor_ = zFactor; dirty_ = true; };
+	inline void setAmbient(const float ambient) { ambient_ = ambient; dirty_ = true; };
+
+	// 0: one per hardware thread
+	inline void setThreads(const int threads) { threads_ = threads; };
+
+	// render if the view's samples or the settings changed; true if rendered
+	bool update(const GridView& view);
+	inline void invalidate() { dirty_ = true; };
+
+	inline int getWidth() const { return width_; };
+	inline int getHeight() const { return height_; };
+	inline const unsigned char* getPixels() const { return pixels_.empty() ? NULL : &pixels_[0]; };
+
+	// incremented by every render, e.g. to know when to upload the texture again
+	inline unsigned int getGeneration() const { return generation_; };
+
+protected:
+
+	void buildColormap();
+	void renderRows(const GridView& view, const int y0, const int y1);
+
+	float minValue_;
+	float maxValue_;
+	Colormap colormap_;
+	float azimuth_;
+	float altitude_;
+	float zFactor_;
+	float ambient_;
+	int threads_;
+
+	bool dirty_;
+	uint64_t hash_;
+	int width_;
+	int height_;
+	unsigned int generation_;
+	unsigned char lut_[257][4];		// RGBA, entry 256 for samples without a finite height
+	std::vector<unsigned char> pixels_;
+};
+
+
+#endif
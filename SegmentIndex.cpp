@@ -0,0 +1,204 @@
+#include "SegmentIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//-----------------------------------------------------------------------------
+SegmentIndex::SegmentIndex()
+	:frameX_(0)
+	,frameY_(0)
+	,shift_(4)
+	,bucketsX_(1)
+	,bucketsY_(1)
+	,bucketStart_(2, 0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void SegmentIndex::reset(const int frameX, const int frameY, const int cellsX, const int cellsY, const int bucketCells)
+{
+	frameX_ = frameX;
+	frameY_ = frameY;
+
+	shift_ = 0;
+
+	while ((1 << shift_) < bucketCells && shift_ < 30)
+		++shift_;
+
+	const int size = 1 << shift_;
+
+	bucketsX_ = std::max((cellsX + size - 1) >> shift_, 1);
+	bucketsY_ = std::max((cellsY + size - 1) >> shift_, 1);
+
+	pending_.clear();
+	pendingBuckets_.clear();
+	segments_.clear();
+	bucketStart_.assign(static_cast<size_t>(bucketsX_)*bucketsY_ + 1, 0);
+}
+
+
+//
+void SegmentIndex::finalize()
+{
+	if (pending_.empty())
+		return;
+
+	const int buckets = bucketsX_*bucketsY_;
+
+	// segments of an earlier finalize() keep their buckets
+	for (int b = 0; b < buckets; ++b)
+	{
+		for (int k = bucketStart_[b]; k < bucketStart_[b + 1]; ++k)
+		{
+			pending_.push_back(segments_[k]);
+			pendingBuckets_.push_back(b);
+		}
+	}
+
+	std::vector<int> start(buckets + 1, 0);
+
+	for (size_t k = 0; k < pendingBuckets_.size(); ++k)
+		++start[pendingBuckets_[k] + 1];
+
+	for (int b = 0; b < buckets; ++b)
+		start[b + 1] += start[b];
+
+	bucketStart_ = start;
+	segments_.resize(pending_.size());
+
+	for (size_t k = 0; k < pending_.size(); ++k)
+		segments_[start[pendingBuckets_[k]]++] = pending_[k];
+
+	std::vector<Segment>().swap(pending_);
+	std::vector<int>().swap(pendingBuckets_);
+}
+
+
+//-----------------------------------------------------------------------------
+void SegmentIndex::query(const float xMin, const float yMin, const float xMax, const float yMax, std::vector<int>& result) const
+{
+	result.clear();
+
+	if (segments_.empty() || !(xMin <= xMax && yMin <= yMax))
+		return;
+
+	// a cell's segments reach one unit past its origin
+	const int size = 1 << shift_;
+	const int bx0 = std::max(static_cast<int>(floorf((xMin - frameX_ - 1.0f)/size)), 0);
+	const int by0 = std::max(static_cast<int>(floorf((yMin - frameY_ - 1.0f)/size)), 0);
+	const int bx1 = std::min(static_cast<int>(floorf((xMax - frameX_)/size)), bucketsX_ - 1);
+	const int by1 = std::min(static_cast<int>(floorf((yMax - frameY_)/size)), bucketsY_ - 1);
+
+	for (int by = by0; by <= by1; ++by)
+	{
+		for (int bx = bx0; bx <= bx1; ++bx)
+		{
+			const int b = by*bucketsX_ + bx;
+
+			for (int k = bucketStart_[b]; k < bucketStart_[b + 1]; ++k)
+			{
+				const Segment& s = segments_[k];
+
+				// clip the segment against the rectangle (Liang-Barsky)
+				const float dx = s.x2 - s.x1;
+				const float dy = s.y2 - s.y1;
+				const float p[4] = { -dx, dx, -dy, dy };
+				const float q[4] = { s.x1 - xMin, xMax - s.x1, s.y1 - yMin, yMax - s.y1 };
+				float t0 = 0.0f;
+				float t1 = 1.0f;
+				bool inside = true;
+
+				for (int e = 0; e < 4 && inside; ++e)
+				{
+					if (p[e] == 0.0f)
+						inside = q[e] >= 0.0f;
+					else if (p[e] < 0.0f)
+						t0 = std::max(t0, q[e]/p[e]);
+					else
+						t1 = std::min(t1, q[e]/p[e]);
+				}
+
+				if (inside && t0 <= t1)
+					result.push_back(k);
+			}
+		}
+	}
+}
+
+
+//
+int SegmentIndex::nearest(const float x, const float y, float& distance) const
+{
+	distance = std::numeric_limits<float>::infinity();
+
+	if (segments_.empty())
+		return -1;
+
+	const int size = 1 << shift_;
+	const int cx = std::min(std::max(static_cast<int>(floorf((x - frameX_)/size)), 0), bucketsX_ - 1);
+	const int cy = std::min(std::max(static_cast<int>(floorf((y - frameY_)/size)), 0), bucketsY_ - 1);
+	const int rings = std::max(bucketsX_, bucketsY_);
+
+	int best = -1;
+
+	// after ring r every unvisited bucket is at least r buckets away
+	for (int r = 0; r <= rings && distance > static_cast<float>(r - 1)*size; ++r)
+	{
+		for (int by = cy - r; by <= cy + r; ++by)
+		{
+			if (by < 0 || by >= bucketsY_)
+				continue;
+
+			// inner rows only need the two ends of the ring
+			const int step = (by == cy - r || by == cy + r) ? 1 : std::max(2*r, 1);
+
+			for (int bx = cx - r; bx <= cx + r; bx += step)
+			{
+				if (bx < 0 || bx >= bucketsX_)
+					continue;
+
+				const int b = by*bucketsX_ + bx;
+
+				for (int k = bucketStart_[b]; k < bucketStart_[b + 1]; ++k)
+				{
+					const float d = pointDistance(segments_[k], x, y);
+
+					if (d < distance)
+					{
+						distance = d;
+						best = k;
+					}
+				}
+			}
+		}
+	}
+
+	return best;
+}
+
+
+//-----------------------------------------------------------------------------
+float SegmentIndex::pointDistance(const Segment& s, const float x, const float y)
+{
+	const float dx = s.x2 - s.x1;
+	const float dy = s.y2 - s.y1;
+	const float length2 = dx*dx + dy*dy;
+
+	float t = (length2 > 0.0f) ? ((x - s.x1)*dx + (y - s.y1)*dy)/length2 : 0.0f;
+	t = std::min(std::max(t, 0.0f), 1.0f);
+
+	const float ex = s.x1 + t*dx - x;
+	const float ey = s.y1 + t*dy - y;
+
+	return sqrtf(ex*ex + ey*ey);
+}
+
+
+//
+size_t SegmentIndex::getMemoryUsage() const
+{
+	return segments_.capacity()*sizeof(Segment) + bucketStart_.capacity()*sizeof(int)
+		 + pending_.capacity()*sizeof(Segment) + pendingBuckets_.capacity()*sizeof(int);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef SEGMENTINDEX_H_INCLUDED
+#define SEGMENTINDEX_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+// Bucket grid over extracted segments.
+//
+// SegmentIndex is a computeIsolines() sink: each segment is appended with
+// the bucket of the cell that produced it (square blocks of bucketCells
+// cells), and finalize() groups the segments by bucket with a counting
+// sort. A segment never leaves its cell, so rectangle queries only visit
+// the buckets under the rectangle and nearest-segment queries search rings
+// of buckets outwards from the query point, stopping as soon as no closer
+// segment can exist. Several levels can be added before finalize().
+
+class SegmentIndex
+{
+public:
+
+	struct Segment
+	{
+		float x1;
+		float y1;
+		float x2;
+		float y2;
+		float level;
+	};
+
+	SegmentIndex();
+
+	// frame and size (in cells) of the extracted view; bucketCells is rounded to a power of two
+	void reset(const int frameX, const int frameY, const int cellsX, const int cellsY, const int bucketCells = 16);
+
+	// segment sink for MarchingSquares::computeIsolines(threshold, sink) and IsolineCursor
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int cellX, const int cellY, const float level)
+	{
+		int bx = (cellX - frameX_) >> shift_;
+		int by = (cellY - frameY_) >> shift_;
+		bx = (bx < 0) ? 0 : (bx < bucketsX_ ? bx : bucketsX_ - 1);
+		by = (by < 0) ? 0 : (by < bucketsY_ ? by : bucketsY_ - 1);
+
+		const Segment s = { x1, y1, x2, y2, level };
+		pending_.push_back(s);
+		pendingBuckets_.push_back(by*bucketsX_ + bx);
+	}
+
+	// group the segments added since reset() by bucket; queries need it
+	void finalize();
+
+	inline bool isFinalized() const { return pending_.empty(); };
+	inline int size() const { return static_cast<int>(segments_.size()); };
+	inline const Segment& getSegment(const int index) const { return segments_[index]; };
+
+	// segments crossing the rectangle (borders included)
+	void query(const float xMin, const float yMin, const float xMax, const float yMax, std::vector<int>& result) const;
+
+	// closest segment to (x, y) and its distance, -1 if the index is empty
+	int nearest(const float x, const float y, float& distance) const;
+
+	// bytes used by the index
+	size_t getMemoryUsage() const;
+
+protected:
+
+	static float pointDistance(const Segment& s, const float x, const float y);
+
+	int frameX_;
+	int frameY_;
+	int shift_;
+	int bucketsX_;
+	int bucketsY_;
+	std::vector<Segment> pending_;
+	std::vector<int> pendingBuckets_;
+	std::vector<Segment> segments_;		// grouped by bucket
+	std::vector<int> bucketStart_;		// bucketsX*bucketsY + 1 offsets into segments_
+};
+
+
+#endif
@@ -0,0 +1,185 @@
+#include "SegmentStore.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+//
+static bool seekFile(FILE* file, const long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+SegmentStore::SegmentStore(const size_t maxBytes)
+	:maxBytes_(maxBytes)
+	,openLevel_(0.0f)
+	,segments_(0)
+	,residentBytes_(0)
+	,peakBytes_(0)
+	,spillFile_(NULL)
+	,spillEnd_(0)
+	,spilledChunks_(0)
+	,spilledBytes_(0)
+	,good_(true)
+{
+}
+
+
+//
+SegmentStore::~SegmentStore()
+{
+	if (spillFile_ != NULL)
+		fclose(spillFile_);
+}
+
+
+//
+void SegmentStore::clear()
+{
+	if (spillFile_ != NULL)
+		fclose(spillFile_);
+
+	std::vector<Chunk>().swap(chunks_);
+	std::vector<float>().swap(open_);
+	openLevel_ = 0.0f;
+	segments_ = 0;
+	residentBytes_ = 0;
+	peakBytes_ = 0;
+	spillFile_ = NULL;
+	spillEnd_ = 0;
+	spilledChunks_ = 0;
+	spilledBytes_ = 0;
+	good_ = true;
+}
+
+
+//
+bool SegmentStore::finish()
+{
+	if (!open_.empty())
+		completeChunk();
+
+	return good_;
+}
+
+
+//-----------------------------------------------------------------------------
+void SegmentStore::completeChunk()
+{
+	peakBytes_ = std::max(peakBytes_, getMemoryUsage());
+
+	chunks_.push_back(Chunk());
+	Chunk& chunk = chunks_.back();
+	chunk.level = openLevel_;
+	chunk.count = static_cast<int>(open_.size()/4);
+	chunk.data.assign(open_.begin(), open_.end());
+
+	segments_ += chunk.count;
+	residentBytes_ += chunk.data.size()*sizeof(float);
+	open_.clear();
+
+	// once spilling failed everything stays in memory, over the budget but complete
+	if (maxBytes_ > 0 && good_ && getMemoryUsage() >= maxBytes_)
+		good_ = spill();
+
+	peakBytes_ = std::max(peakBytes_, getMemoryUsage());
+}
+
+
+//
+bool SegmentStore::spill()
+{
+	if (spillFile_ == NULL && !openSpillFile())
+		return false;
+
+	// chunks are spilled in order, so the resident ones are at the end
+	for (size_t k = spilledChunks_; k < chunks_.size(); ++k)
+	{
+		Chunk& chunk = chunks_[k];
+		const size_t bytes = chunk.data.size()*sizeof(float);
+
+		if (!seekFile(spillFile_, spillEnd_) || fwrite(&chunk.data[0], bytes, 1, spillFile_) != 1)
+			return false;
+
+		chunk.offset = spillEnd_;
+		std::vector<float>().swap(chunk.data);
+
+		spillEnd_ += bytes;
+		spilledBytes_ += bytes;
+		residentBytes_ -= bytes;
+		++spilledChunks_;
+	}
+
+	return fflush(spillFile_) == 0;
+}
+
+
+//
+bool SegmentStore::openSpillFile()
+{
+#ifndef _WIN32
+	// an unlinked file disappears with the descriptor, even after a crash
+	if (!spillDirectory_.empty())
+	{
+		std::string path = spillDirectory_ + "/segments_XXXXXX";
+		const int fd = mkstemp(&path[0]);
+
+		if (fd < 0)
+			return false;
+
+		unlink(path.c_str());
+		spillFile_ = fdopen(fd, "w+b");
+
+		if (spillFile_ == NULL)
+			close(fd);
+
+		return spillFile_ != NULL;
+	}
+#endif
+
+	spillFile_ = tmpfile();
+	return spillFile_ != NULL;
+}
+
+
+//
+bool SegmentStore::readChunk(const Chunk& chunk, std::vector<float>& data) const
+{
+	data.resize(4*static_cast<size_t>(chunk.count));
+
+	return spillFile_ != NULL && seekFile(spillFile_, chunk.offset)
+		&& fread(&data[0], data.size()*sizeof(float), 1, spillFile_) == 1;
+}
+
+
+//-----------------------------------------------------------------------------
+bool SegmentStore::Reader::next(const float*& segments, int& count, float& level)
+{
+	if (chunk_ >= store_.chunks_.size())
+		return false;
+
+	const Chunk& chunk = store_.chunks_[chunk_];
+
+	if (chunk.offset < 0)
+		segments = &chunk.data[0];
+	else if (store_.readChunk(chunk, buffer_))
+		segments = &buffer_[0];
+	else
+		return false;
+
+	count = chunk.count;
+	level = chunk.level;
+	++chunk_;
+
+	return true;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef SEGMENTSTORE_H_INCLUDED
+#define SEGMENTSTORE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Extraction output under a memory budget.
+//
+// SegmentStore is a computeIsolines() sink that packs segments (x1,y1,x2,y2)
+// into chunks of one level each. Completed chunks stay in memory until they
+// reach the budget; then they are all appended to an unnamed spill file as
+// raw floats and their memory is released, so memory stays below the budget
+// plus one open chunk whatever the size of the output. Readers walk the
+// chunks in the order they were produced, loading spilled ones on demand,
+// so callers see the same sequence as with a plain SegmentBufferSink.
+
+class SegmentStore
+{
+public:
+
+	// segments per chunk, 256 KB of floats
+	static const int CHUNK_SEGMENTS = 16384;
+
+	// 0: no budget, everything stays in memory
+	explicit SegmentStore(const size_t maxBytes = 0);
+	~SegmentStore();
+
+	inline void setMaxBytes(const size_t maxBytes) { maxBytes_ = maxBytes; };
+	inline size_t getMaxBytes() const { return maxBytes_; };
+
+	// the spill file is created in this directory (default: the system temporary
+	// directory); keep it off tmpfs when the point is to save memory
+	inline void setSpillDirectory(const std::string& directory) { spillDirectory_ = directory; };
+
+	// drop all segments and the spill file
+	void clear();
+
+	// segment sink for MarchingSquares::computeIsolines(threshold, sink) and IsolineCursor
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int, const int, const float level)
+	{
+		if (open_.size() == 4*static_cast<size_t>(CHUNK_SEGMENTS) || (level != openLevel_ && !open_.empty()))
+			completeChunk();
+
+		openLevel_ = level;
+		open_.push_back(x1);
+		open_.push_back(y1);
+		open_.push_back(x2);
+		open_.push_back(y2);
+	}
+
+	// complete the last chunk; false if the spill file could not be written, in
+	// which case the remaining chunks were kept in memory, over the budget
+	bool finish();
+
+	inline bool good() const { return good_; };
+	inline size_t size() const { return segments_ + open_.size()/4; };
+	inline int getChunks() const { return static_cast<int>(chunks_.size()); };
+	inline int getSpilledChunks() const { return spilledChunks_; };
+	inline size_t getSpilledBytes() const { return spilledBytes_; };
+
+	// bytes of segment data currently in memory, and the most there ever was
+	inline size_t getMemoryUsage() const { return residentBytes_ + open_.capacity()*sizeof(float); };
+	inline size_t getPeakMemoryUsage() const { return peakBytes_; };
+
+	// Iterates the chunks of a finished store in extraction order. Spilled
+	// chunks are read into the reader's own buffer, valid until the next call.
+	// Readers share the spill file, so use them from one thread at a time.
+	class Reader
+	{
+	public:
+
+		explicit Reader(const SegmentStore& store) : store_(store), chunk_(0) {}
+
+		// next chunk: count segments of 4 floats at one level; false at the end or on a read error
+		bool next(const float*& segments, int& count, float& level);
+		inline void rewind() { chunk_ = 0; };
+
+	protected:
+
+		const SegmentStore& store_;
+		size_t chunk_;
+		std::vector<float> buffer_;
+	};
+
+protected:
+
+	struct Chunk
+	{
+		Chunk() : level(0.0f), count(0), offset(-1) {}
+
+		float level;
+		int count;
+		long long offset;			// in the spill file, -1 while in memory
+		std::vector<float> data;	// empty once spilled
+	};
+
+	void completeChunk();
+	bool spill();
+	bool openSpillFile();
+	bool readChunk(const Chunk& chunk, std::vector<float>& data) const;
+
+	SegmentStore(const SegmentStore&);
+	SegmentStore& operator = (const SegmentStore&);
+
+	size_t maxBytes_;
+	std::string spillDirectory_;
+
+	std::vector<Chunk> chunks_;
+	std::vector<float> open_;
+	float openLevel_;
+	size_t segments_;			// in chunks_
+	size_t residentBytes_;
+	size_t peakBytes_;
+
+	FILE* spillFile_;
+	long long spillEnd_;
+	int spilledChunks_;
+	size_t spilledBytes_;
+	bool good_;
+};
+
+
+#endif
@@ -0,0 +1,384 @@
+#include "ShardedExtractor.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const int32_t BAND_EXIT = -1;
+
+
+//
+static bool sendAll(const int socket, const void* data, size_t size)
+{
+	const char* p = static_cast<const char*>(data);
+
+	while (size > 0)
+	{
+		const ssize_t n = send(socket, p, size, MSG_NOSIGNAL);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			return false;
+
+		p += n;
+		size -= n;
+	}
+
+	return true;
+}
+
+
+//
+static bool receiveAll(const int socket, void* data, size_t size)
+{
+	char* p = static_cast<char*>(data);
+
+	while (size > 0)
+	{
+		const ssize_t n = recv(socket, p, size, 0);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			return false;
+
+		p += n;
+		size -= n;
+	}
+
+	return true;
+}
+#endif
+
+
+//-----------------------------------------------------------------------------
+ShardedExtractor::ShardedExtractor()
+	:workers_(4)
+	,bandRows_(256)
+	,maxRestarts_(8)
+	,bandTimeout_(60000)
+	,bands_(0)
+	,restarts_(0)
+	,timeouts_(0)
+	,threshold_(0.0f)
+{
+}
+
+
+//
+ShardedExtractor::~ShardedExtractor()
+{
+}
+
+
+//
+bool ShardedExtractor::setBandRows(const int rows)
+{
+	if (rows < 1)
+		return false;
+
+	bandRows_ = rows;
+	return true;
+}
+
+
+#ifdef _WIN32
+
+//-----------------------------------------------------------------------------
+bool ShardedExtractor::computeIsolines(const GridView&, const float, std::vector<float>&)
+{
+	return false;
+}
+
+#else
+
+//-----------------------------------------------------------------------------
+bool ShardedExtractor::computeIsolines(const GridView& view, const float threshold, std::vector<float>& segments)
+{
+	segments.clear();
+	restarts_ = 0;
+	timeouts_ = 0;
+
+	const int cellsY = std::max(view.height - 1, 0);
+
+	// workers split the view with the same bandRows_
+	bands_ = (cellsY + bandRows_ - 1)/bandRows_;
+
+	if (bands_ == 0 || view.width < 2)
+		return true;
+
+	// workers forked from here on read the caller's samples in place
+	view_ = view;
+	threshold_ = threshold;
+
+	std::vector< std::vector<float> > results(bands_);
+	std::deque<int> pending;
+
+	for (int b = 0; b < bands_; ++b)
+		pending.push_back(b);
+
+	pool_.assign(std::min(std::max(workers_, 1), bands_), Worker());
+
+	MarchingSquares local;		// bands of workers that timed out
+	bool ok = true;
+	int completed = 0;
+
+	for (size_t w = 0; ok && w < pool_.size(); ++w)
+		ok = startWorker(w);
+
+	std::vector<pollfd> fds(pool_.size());
+
+	while (ok && completed < bands_)
+	{
+		// hand out bands to idle workers
+		for (size_t w = 0; ok && w < pool_.size(); ++w)
+		{
+			if (pool_[w].band >= 0 || pending.empty())
+				continue;
+
+			const int band = pending.front();
+			pending.pop_front();
+
+			if (assignBand(w, band))
+				continue;
+
+			// the worker is gone: give the band back and replace it
+			pending.push_front(band);
+			stopWorker(w, true);
+			ok = ++restarts_ <= maxRestarts_ && startWorker(w);
+		}
+
+		// wait until a band arrives or the earliest one is overdue
+		double due = -1.0;
+
+		for (size_t w = 0; w < pool_.size(); ++w)
+		{
+			fds[w].fd = (pool_[w].band >= 0) ? pool_[w].socket : -1;
+			fds[w].events = POLLIN;
+			fds[w].revents = 0;
+
+			if (pool_[w].band >= 0 && (due < 0.0 || pool_[w].deadline < due))
+				due = pool_[w].deadline;
+		}
+
+		const double wait = std::max(due - PerfCounters::now(), 0.0)*1000.0;
+		const int ready = ok ? poll(&fds[0], fds.size(), static_cast<int>(std::min(ceil(wait), 2e9))) : 0;
+
+		if (!ok || ready < 0)
+		{
+			ok = ok && errno == EINTR;
+			continue;
+		}
+
+		const double now = PerfCounters::now();
+
+		for (size_t w = 0; ok && w < pool_.size(); ++w)
+		{
+			const int band = pool_[w].band;
+
+			if (band < 0)
+				continue;
+
+			if (fds[w].revents == 0)
+			{
+				if (now < pool_[w].deadline)
+					continue;
+
+				// hung or stalled: replace the worker, compute the band here
+				++timeouts_;
+				stopWorker(w, true);
+				computeBand(local, band, results[band]);
+				++completed;
+				ok = ++restarts_ <= maxRestarts_ && startWorker(w);
+				continue;
+			}
+
+			if (receiveBand(w, results[band]))
+			{
+				++completed;
+				continue;
+			}
+
+			pending.push_front(band);
+			stopWorker(w, true);
+			ok = ++restarts_ <= maxRestarts_ && startWorker(w);
+		}
+	}
+
+	for (size_t w = 0; w < pool_.size(); ++w)
+		stopWorker(w, !ok);
+
+	pool_.clear();
+	view_ = GridView();
+
+	if (!ok)
+		return false;
+
+	size_t total = 0;
+
+	for (int b = 0; b < bands_; ++b)
+		total += results[b].size();
+
+	segments.reserve(total);
+
+	for (int b = 0; b < bands_; ++b)
+		segments.insert(segments.end(), results[b].begin(), results[b].end());
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool ShardedExtractor::startWorker(const size_t index)
+{
+	int sockets[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+		return false;
+
+	const pid_t pid = fork();
+
+	if (pid < 0)
+	{
+		close(sockets[0]);
+		close(sockets[1]);
+		return false;
+	}
+
+	if (pid == 0)
+	{
+		// only this worker's end stays open in the child
+		for (size_t w = 0; w < pool_.size(); ++w)
+			if (pool_[w].socket >= 0)
+				close(pool_[w].socket);
+
+		close(sockets[0]);
+		workerLoop(sockets[1]);
+		_exit(0);
+	}
+
+	close(sockets[1]);
+
+	Worker& worker = pool_[index];
+	worker.pid = pid;
+	worker.socket = sockets[0];
+	worker.band = -1;
+
+	return true;
+}
+
+
+//
+void ShardedExtractor::stopWorker(const size_t index, const bool kill)
+{
+	Worker& worker = pool_[index];
+
+	if (worker.socket >= 0)
+	{
+		if (!kill)
+			sendAll(worker.socket, &BAND_EXIT, sizeof(BAND_EXIT));
+
+		close(worker.socket);
+	}
+
+	if (worker.pid > 0)
+	{
+		if (kill)
+			::kill(worker.pid, SIGKILL);
+
+		while (waitpid(worker.pid, NULL, 0) < 0 && errno == EINTR)
+			;
+	}
+
+	worker = Worker();
+}
+
+
+//
+bool ShardedExtractor::assignBand(const size_t index, const int band)
+{
+	const int32_t message = band;
+
+	if (!sendAll(pool_[index].socket, &message, sizeof(message)))
+		return false;
+
+	pool_[index].band = band;
+	pool_[index].deadline = PerfCounters::now() + bandTimeout_*0.001;
+	return true;
+}
+
+
+//
+bool ShardedExtractor::receiveBand(const size_t index, std::vector<float>& segments)
+{
+	Worker& worker = pool_[index];
+	int32_t band;
+	uint32_t count;
+
+	if (!receiveAll(worker.socket, &band, sizeof(band)) || band != worker.band
+	 || !receiveAll(worker.socket, &count, sizeof(count)))
+		return false;
+
+	segments.resize(count);
+
+	if (count > 0 && !receiveAll(worker.socket, &segments[0], count*sizeof(float)))
+		return false;
+
+	worker.band = -1;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+void ShardedExtractor::workerLoop(const int socket)
+{
+	MarchingSquares marchingSquares;
+	std::vector<float> segments;
+	int32_t band;
+
+	while (receiveAll(socket, &band, sizeof(band)) && band != BAND_EXIT)
+	{
+		computeBand(marchingSquares, band, segments);
+
+		const uint32_t count = static_cast<uint32_t>(segments.size());
+
+		if (!sendAll(socket, &band, sizeof(band)) || !sendAll(socket, &count, sizeof(count))
+		 || (count > 0 && !sendAll(socket, &segments[0], count*sizeof(float))))
+			break;
+	}
+
+	close(socket);
+}
+
+
+//
+void ShardedExtractor::computeBand(MarchingSquares& marchingSquares, const int band, std::vector<float>& segments) const
+{
+	// band cells plus the sample row shared with the next band
+	const int y0 = band*bandRows_;
+	const int rows = std::min(bandRows_, view_.height - 1 - y0) + 1;
+
+	marchingSquares.setGridView(view_.subView(0, y0, view_.width, rows));
+
+	segments.clear();
+	SegmentBufferSink sink(segments);
+	marchingSquares.computeIsolines(threshold_, sink);
+}
+
+#endif
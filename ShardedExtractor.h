@@ -0,0 +1,85 @@
+#pragma once
+#ifndef SHARDEDEXTRACTOR_H_INCLUDED
+#define SHARDEDEXTRACTOR_H_INCLUDED
+
+#include "MarchingSquares.h"
+#include <sys/types.h>
+#include <vector>
+
+// Isoline extraction spread over worker processes (POSIX only).
+//
+// The grid is split into bands of cell rows. The calling process acts as
+// coordinator: it forks the workers, which read the caller's view through
+// their copy-on-write image of its memory (nothing is copied), hands out
+// one band at a time over a Unix socket pair per worker and collects each
+// band's segments as packed floats. Bands share their boundary sample row,
+// so every cell belongs to exactly one band and stitching reduces to
+// concatenating the bands in order; the result equals
+// MarchingSquares::computeIsolines() on the whole view. A worker that dies
+// is restarted and its band handed out again; one that does not answer
+// within the band timeout is killed and restarted, and the coordinator
+// computes that band itself.
+
+class ShardedExtractor
+{
+public:
+
+	ShardedExtractor();
+	~ShardedExtractor();
+
+	inline void setWorkers(const int workers) { workers_ = workers; };
+	// cell rows per band; false (and unchanged) for rows < 1
+	bool setBandRows(const int rows);
+	inline int getBandRows() const { return bandRows_; };
+	inline void setMaxRestarts(const int restarts) { maxRestarts_ = restarts; };
+	// milliseconds a worker may take for a band before it is replaced and
+	// the band is computed in the calling process
+	inline void setBandTimeout(const int milliseconds) { bandTimeout_ = milliseconds; };
+	inline int getBandTimeout() const { return bandTimeout_; };
+
+	// segments (x1,y1,x2,y2) in the view's frame; false if workers could not
+	// be started or a band still failed after maxRestarts restarts
+	bool computeIsolines(const GridView& view, const float threshold, std::vector<float>& segments);
+
+	inline int getBands() const { return bands_; };
+	inline int getRestarts() const { return restarts_; };
+	inline int getTimeouts() const { return timeouts_; };
+
+protected:
+
+	struct Worker
+	{
+		Worker() : pid(-1), socket(-1), band(-1), deadline(0.0) {}
+
+		pid_t pid;
+		int socket;		// coordinator end
+		int band;		// in flight, -1 when idle
+		double deadline;	// PerfCounters::now() by which the band is due
+	};
+
+	bool startWorker(const size_t index);
+	void stopWorker(const size_t index, const bool kill);
+	bool assignBand(const size_t index, const int band);
+	bool receiveBand(const size_t index, std::vector<float>& segments);
+	void workerLoop(const int socket);
+	void computeBand(MarchingSquares& marchingSquares, const int band, std::vector<float>& segments) const;
+
+	ShardedExtractor(const ShardedExtractor&);
+	ShardedExtractor& operator = (const ShardedExtractor&);
+
+	std::vector<Worker> pool_;
+	int workers_;
+	int bandRows_;
+	int maxRestarts_;
+	int bandTimeout_;
+	int bands_;
+	int restarts_;
+	int timeouts_;
+
+	// seen by the workers as of their fork
+	GridView view_;
+	float threshold_;
+};
+
+
+#endif
@@ -0,0 +1,112 @@
+#include "SupersampledGrid.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+SupersampledGrid::SupersampledGrid()
+	:frameX_(0)
+	,frameY_(0)
+	,factor_(4)
+	,interpolation_(INTERPOLATION_BILINEAR)
+	,taps_(2)
+	,refinedCells_(0)
+{
+	buildWeights();
+}
+
+
+//-----------------------------------------------------------------------------
+void SupersampledGrid::setGridView(const GridView& view)
+{
+	setGridView(view, view.originX, view.originY);
+}
+
+
+//
+void SupersampledGrid::setGridView(const GridView& view, const int frameX, const int frameY)
+{
+	grid_ = view;
+	frameX_ = frameX;
+	frameY_ = frameY;
+}
+
+
+//
+void SupersampledGrid::setFactor(const int factor)
+{
+	factor_ = std::max(factor, 1);
+	buildWeights();
+}
+
+
+//-----------------------------------------------------------------------------
+void SupersampledGrid::buildWeights()
+{
+	taps_ = (interpolation_ == INTERPOLATION_BICUBIC) ? 4 : 2;
+	weights_.resize(static_cast<size_t>(factor_ + 1)*taps_);
+	offsets_.resize(factor_ + 1);
+
+	for (int i = 0; i <= factor_; ++i)
+	{
+		// exactly 0 and 1 at both ends, so border sub-samples are the samples
+		const float t = static_cast<float>(i)/factor_;
+		float* w = &weights_[static_cast<size_t>(i)*taps_];
+
+		offsets_[i] = t;
+
+		if (taps_ == 2)
+		{
+			w[0] = 1.0f - t;
+			w[1] = t;
+		}
+		else
+		{
+			w[0] = 0.5f*((-t + 2.0f)*t - 1.0f)*t;
+			w[1] = 0.5f*((3.0f*t - 5.0f)*t*t + 2.0f);
+			w[2] = 0.5f*((-3.0f*t + 4.0f)*t + 1.0f)*t;
+			w[3] = 0.5f*(t - 1.0f)*t*t;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+void SupersampledGrid::sampleCell(const int x, const int y, float* samples) const
+{
+	const int n = factor_ + 1;
+	const int first = (taps_ == 4) ? -1 : 0;
+
+	int columns[4];
+	const float* rows[4];
+
+	for (int t = 0; t < taps_; ++t)
+	{
+		columns[t] = std::min(std::max(x + first + t, 0), grid_.width - 1);
+		rows[t] = grid_.row(std::min(std::max(y + first + t, 0), grid_.height - 1));
+	}
+
+	for (int j = 0; j < n; ++j)
+	{
+		const float* wy = &weights_[static_cast<size_t>(j)*taps_];
+		float* out = samples + static_cast<size_t>(j)*n;
+
+		for (int i = 0; i < n; ++i)
+		{
+			const float* wx = &weights_[static_cast<size_t>(i)*taps_];
+			float value = 0.0f;
+
+			// across first, then down, in the same order for every cell
+			for (int r = 0; r < taps_; ++r)
+			{
+				float across = 0.0f;
+
+				for (int t = 0; t < taps_; ++t)
+					across += wx[t]*rows[r][columns[t]];
+
+				value += wy[r]*across;
+			}
+
+			out[i] = value;
+		}
+	}
+}
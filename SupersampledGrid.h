@@ -0,0 +1,139 @@
+#pragma once
+#ifndef SUPERSAMPLEDGRID_H_INCLUDED
+#define SUPERSAMPLEDGRID_H_INCLUDED
+
+#include "MarchingSquares.h"
+#include <vector>
+
+// Contours of a heightmap interpolated at a finer spacing, on the fly.
+//
+// The view is treated as a continuous field, bilinear or bicubic
+// (Catmull-Rom), sampled factor times per cell in each direction. Only
+// cells whose coarse corners straddle the threshold are refined: their
+// (factor+1)^2 sub-samples are evaluated into a small scratch buffer and
+// contoured as factor^2 sub-cells, so the upsampled grid never exists.
+// Sub-samples on a cell border depend only on the samples along that
+// border, so neighbouring cells agree and the lines stay closed. A
+// bilinear cell cannot cross the threshold unless its corners do, so
+// nothing is missed; a bicubic one can overshoot, and such crossings in
+// cells whose corners do not straddle are not extracted.
+
+class SupersampledGrid
+{
+public:
+
+	enum Interpolation
+	{
+		INTERPOLATION_BILINEAR = 0,
+		INTERPOLATION_BICUBIC		// Catmull-Rom, samples clamped at the view border
+	};
+
+	SupersampledGrid();
+
+	// output frame as in MarchingSquares::setGridView()
+	void setGridView(const GridView& view);
+	void setGridView(const GridView& view, const int frameX, const int frameY);
+
+	// sub-cells per cell side
+	void setFactor(const int factor);
+	inline int getFactor() const { return factor_; };
+
+	inline void setInterpolation(const Interpolation interpolation) { interpolation_ = interpolation; buildWeights(); };
+	inline Interpolation getInterpolation() const { return interpolation_; };
+
+	// segments in the frame, each reported with the coarse cell it lies in
+	template <class Sink>
+	void computeIsolines(const float threshold, Sink& sink);
+
+	// (factor+1)^2 sub-samples of cell (x, y), row-major
+	void sampleCell(const int x, const int y, float* samples) const;
+
+	// cells refined by the last computeIsolines()
+	inline long long getRefinedCells() const { return refinedCells_; };
+
+protected:
+
+	void buildWeights();
+
+	GridView grid_;
+	int frameX_;
+	int frameY_;
+	int factor_;
+	Interpolation interpolation_;
+	int taps_;						// 2 bilinear, 4 bicubic
+	std::vector<float> weights_;	// taps_ per sub-sample position 0..factor
+	std::vector<float> offsets_;	// i/factor, i = 0..factor
+	std::vector<float> samples_;	// scratch of computeIsolines()
+	long long refinedCells_;
+};
+
+
+//-----------------------------------------------------------------------------
+template <class Sink>
+void SupersampledGrid::computeIsolines(const float threshold, Sink& sink)
+{
+	refinedCells_ = 0;
+
+	if (grid_.empty() || grid_.width < 2 || grid_.height < 2)
+		return;
+
+	const int n = factor_ + 1;
+
+	samples_.resize(static_cast<size_t>(n)*n);
+
+	for (int y = 0; y < grid_.height - 1; ++y)
+	{
+		const float* row0 = grid_.row(y);
+		const float* row1 = grid_.row(y + 1);
+
+		for (int x = 0; x < grid_.width - 1; ++x)
+		{
+			const int num = MarchingSquares::classifyCell(row0[x], row0[x+1], row1[x+1], row1[x], threshold);
+
+			if (num == 0 || num == 15)
+				continue;
+
+			++refinedCells_;
+			sampleCell(x, y, &samples_[0]);
+
+			const float ox = static_cast<float>(frameX_ + x);
+			const float oy = static_cast<float>(frameY_ + y);
+
+			for (int j = 0; j < factor_; ++j)
+			{
+				const float* s0 = &samples_[static_cast<size_t>(j)*n];
+				const float* s1 = s0 + n;
+
+				// sub-cell borders from the same offsets on both sides, so
+				// neighbouring cells and sub-cells share their end points
+				const float y0 = oy + offsets_[j];
+				const float dy = (oy + offsets_[j+1]) - y0;
+
+				for (int i = 0; i < factor_; ++i)
+				{
+					const float a = s0[i];
+					const float b = s0[i+1];
+					const float c = s1[i+1];
+					const float d = s1[i];
+
+					const int sub = MarchingSquares::classifyCell(a, b, c, d, threshold);
+
+					if (sub == 0 || sub == 15)
+						continue;
+
+					const float x0 = ox + offsets_[i];
+					const float dx = (ox + offsets_[i+1]) - x0;
+
+					float s[8];
+					const int count = MarchingSquares::cellSegments(sub, x0, y0, dx, dy, a, b, c, d, threshold, s);
+
+					for (int k = 0; k < count; ++k)
+						sink.segment(s[4*k], s[4*k+1], s[4*k+2], s[4*k+3], frameX_ + x, frameY_ + y, threshold);
+				}
+			}
+		}
+	}
+}
+
+
+#endif
@@ -0,0 +1,1974 @@
+// Command line benchmarks for the extraction kernels.
+//
+//   benchmark tiling [width] [height]
+//   benchmark adaptive [width] [height]
+//   benchmark export [width] [height]    (writes to the current directory)
+//   benchmark sink [width] [height]
+//   benchmark kernel [width] [height]
+//   benchmark index [width] [height]     (writes to the current directory)
+//   benchmark cache [width] [height]
+//   benchmark levels [width] [height]
+//   benchmark sharded [width] [height]
+//   benchmark fixed [width] [height]
+//   benchmark spatial [width] [height]
+//   benchmark relief [width] [height]
+//   benchmark spill [width] [height]
+//   benchmark stats [width] [height]
+//   benchmark supersample [width] [height]
+//   benchmark check                      (correctness checks, exit code 1 on failure)
+//
+// Maps are synthetic (smooth terrain plus noise) so runs are reproducible.
+
+#include "MarchingSquares.h"
+#include "AdaptiveMarchingSquares.h"
+#include "ContourExport.h"
+#include "IsolineCache.h"
+#include "GridAnalysis.h"
+#include "ShardedExtractor.h"
+#include "SegmentIndex.h"
+#include "ReliefRaster.h"
+#include "SegmentStore.h"
+#include "ContourStatistics.h"
+#include "SupersampledGrid.h"
+#include "MarchingSquaresC.h"
+#include "ChunkedHeightMap.h"
+#include "ContourTree.h"
+#include "IsolineCursor.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+static void makeTerrain(std::vector<float>& heights, const int width, const int height, const float noise)
+{
+	heights.resize(static_cast<size_t>(width)*height);
+	unsigned int seed = 12345u;
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			seed = seed*1664525u + 1013904223u;
+			const float n = (seed >> 8)/16777216.0f - 0.5f;
+
+			heights[static_cast<size_t>(y)*width + x] = 0.5f
+				+ 0.25f*sinf(x*0.0021f)*cosf(y*0.0017f)
+				+ 0.15f*sinf(x*0.013f + y*0.007f)
+				+ noise*n;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchTiling(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	static const char* names[3] = { "none", "blocked", "morton" };
+	static const float thresholds[3] = { 0.3f, 0.5f, 0.63f };
+
+	PerfCounters counters;
+	counters.open();
+
+	const long long cells = static_cast<long long>(width - 1)*(height - 1);
+
+	printf("%dx%d, %lld cells%s\n", width, height, cells, counters.isOpen() ? "" : " (hardware counters unavailable, time only)");
+
+	for (int mode = 0; mode < 3; ++mode)
+	{
+		MarchingSquares marchingSquares;
+		marchingSquares.setTiling(static_cast<MarchingSquares::Tiling>(mode));
+
+		PerfSample build;
+		counters.start();
+		marchingSquares.setHeightMap(width, height, &heights[0]);
+		counters.stop(build);
+
+		char label[64];
+		sprintf(label, "%s setup", names[mode]);
+		PerfCounters::report(stdout, label, build, cells, 0);
+
+		for (int k = 0; k < 3; ++k)
+		{
+			PerfSample sample;
+			counters.start();
+			marchingSquares.computeIsolines(thresholds[k]);
+			counters.stop(sample);
+
+			sprintf(label, "%s t=%.2f", names[mode], thresholds[k]);
+			PerfCounters::report(stdout, label, sample, cells, marchingSquares.getIsolineVertexList()->size()/2);
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static float sampleBilinear(const GridView& view, const float x, const float y)
+{
+	const int i = std::min(std::max(static_cast<int>(x), 0), view.width - 2);
+	const int j = std::min(std::max(static_cast<int>(y), 0), view.height - 2);
+	const float u = x - i;
+	const float v = y - j;
+
+	return (view.at(i, j)*(1.0f - u) + view.at(i+1, j)*u)*(1.0f - v)
+		 + (view.at(i, j+1)*(1.0f - u) + view.at(i+1, j+1)*u)*v;
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchAdaptive(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.0f);
+
+	const GridView view = GridView::whole(&heights[0], width, height);
+	const float threshold = 0.5f;
+	static const float tolerances[4] = { -1.0f, 0.0005f, 0.002f, 0.01f };
+
+	PerfCounters counters;
+	PerfSample sample;
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+	counters.start();
+	marchingSquares.computeIsolines(threshold);
+	counters.stop(sample);
+
+	printf("%dx%d smooth terrain, t=%.2f\n", width, height, threshold);
+	printf("exact           %10.3f ms  %8lu segments\n", sample.seconds*1e3,
+		   static_cast<unsigned long>(marchingSquares.getIsolineVertexList()->size()/2));
+
+	AdaptiveMarchingSquares adaptive;
+	counters.start();
+	adaptive.setGridView(view);
+	counters.stop(sample);
+	printf("pyramid build   %10.3f ms\n", sample.seconds*1e3);
+
+	for (int k = 0; k < 4; ++k)
+	{
+		counters.start();
+		adaptive.computeIsolines(threshold, tolerances[k]);
+		counters.stop(sample);
+
+		// value of the exact field at the emitted vertices: 0 error means on the isoline
+		float maxError = 0.0f;
+		std::list< Vec2<float> >* vertices = adaptive.getIsolineVertexList();
+
+		for (std::list< Vec2<float> >::const_iterator it = vertices->begin(); it != vertices->end(); ++it)
+			maxError = std::max(maxError, fabsf(sampleBilinear(view, (*it)[0], (*it)[1]) - threshold));
+
+		printf("tol %-10g  %10.3f ms  %8lu segments  %8lld nodes  max value error %g\n",
+			   tolerances[k], sample.seconds*1e3, static_cast<unsigned long>(vertices->size()/2),
+			   adaptive.getVisitedNodes(), maxError);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchExport(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+	marchingSquares.computeIsolines(0.5f);
+
+	const std::list< Vec2<float> >& vertices = *marchingSquares.getIsolineVertexList();
+	printf("%lu segments\n", static_cast<unsigned long>(vertices.size()/2));
+
+	// the ad hoc dump this replaces
+	double start = PerfCounters::now();
+	{
+		std::ofstream out("bench_ostream.txt");
+
+		for (std::list< Vec2<float> >::const_iterator it = vertices.begin(); it != vertices.end(); ++it)
+			out << (*it)[0] << " " << (*it)[1] << "\n";
+	}
+	printf("ostream          %8.3f s\n", PerfCounters::now() - start);
+
+	GeoJSONWriter geoJSON;
+	geoJSON.setTransform(CoordinateTransform(-46.0, -23.0, 1e-4, 1e-4));
+	geoJSON.setPrecision(6);
+	geoJSON.open("bench.geojson");
+	geoJSON.writeLevel(0.5f, vertices);
+	geoJSON.close();
+	printf("geojson          %8.3f s  %8.1f MB/s\n", geoJSON.getSeconds(), geoJSON.getMegabytesPerSecond());
+
+	GeoJSONWriter shortest;
+	shortest.setPrecision(-1);
+	shortest.open("bench_shortest.geojson");
+	shortest.writeLevel(0.5f, vertices);
+	shortest.close();
+	printf("geojson shortest %8.3f s  %8.1f MB/s\n", shortest.getSeconds(), shortest.getMegabytesPerSecond());
+
+	SVGWriter svg(width, height);
+	svg.setPrecision(2);
+	svg.open("bench.svg");
+	svg.writeLevel(0.5f, vertices);
+	svg.close();
+	printf("svg              %8.3f s  %8.1f MB/s\n", svg.getSeconds(), svg.getMegabytesPerSecond());
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchSink(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+
+	double start = PerfCounters::now();
+	marchingSquares.computeIsolines(0.5f);
+	printf("vertex list      %8.3f s  %lu segments\n", PerfCounters::now() - start,
+		   static_cast<unsigned long>(marchingSquares.getIsolineVertexList()->size()/2));
+
+	SegmentCounter counter;
+	start = PerfCounters::now();
+	marchingSquares.computeIsolines(0.5f, counter);
+	printf("counting sink    %8.3f s  %lld segments, length %.1f\n", PerfCounters::now() - start, counter.segments, counter.length);
+
+	GeoJSONWriter geoJSON;
+	start = PerfCounters::now();
+	geoJSON.open("bench_sink.geojson");
+	geoJSON.beginLevel(0.5f);
+	marchingSquares.computeIsolines(0.5f, geoJSON);
+	geoJSON.endLevel();
+	geoJSON.close();
+	printf("geojson sink     %8.3f s  %8.1f MB/s\n", PerfCounters::now() - start, geoJSON.getMegabytesPerSecond());
+}
+
+
+// keeps the segments observable without storing them
+struct ChecksumSink
+{
+	ChecksumSink() : segments(0), checksum(0.0) {}
+
+	inline void segment(const float x1, const float y1, const float x2, const float y2, const int, const int, const float)
+	{
+		++segments;
+		checksum += x1 + y1 + x2 + y2;
+	}
+
+	long long segments;
+	double checksum;
+};
+
+
+//-----------------------------------------------------------------------------
+static void benchKernel(const int width, const int height)
+{
+	static const char* names[2] = { "scalar", "compact" };
+	static const float noises[2] = { 0.02f, 0.5f };
+
+	for (int n = 0; n < 2; ++n)
+	{
+		std::vector<float> heights;
+		makeTerrain(heights, width, height, noises[n]);
+
+		MarchingSquares marchingSquares;
+		marchingSquares.setHeightMap(width, height, &heights[0]);
+
+		for (int kernel = 0; kernel < 2; ++kernel)
+		{
+			marchingSquares.setKernel(static_cast<MarchingSquares::Kernel>(kernel));
+
+			ChecksumSink sink;
+			const double start = PerfCounters::now();
+			marchingSquares.computeIsolines(0.5f, sink);
+			const double seconds = PerfCounters::now() - start;
+
+			printf("noise %.2f %-8s %8.3f s  %9lld segments  %7.1f Msegments/s  checksum %.6g\n",
+				   noises[n], names[kernel], seconds, sink.segments, sink.segments/(seconds*1e6), sink.checksum);
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchIndex(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	const GridView view = GridView::whole(&heights[0], width, height);
+
+	double start = PerfCounters::now();
+	const unsigned long long hash = IndexFile::contentHash(view);
+	printf("content hash     %8.3f s  %016llx\n", PerfCounters::now() - start, hash);
+
+	remove("bench_tiles.msix");
+	remove("bench_pyramid.msix");
+
+	// build and save, then a fresh instance as after a restart
+	for (int run = 0; run < 2; ++run)
+	{
+		MarchingSquares marchingSquares;
+		marchingSquares.setTiling(MarchingSquares::TILING_MORTON);
+
+		start = PerfCounters::now();
+		const bool loaded = marchingSquares.setGridView(view, "bench_tiles.msix");
+		const double setup = PerfCounters::now() - start;
+
+		ChecksumSink sink;
+		marchingSquares.computeIsolines(0.5f, sink);
+
+		printf("morton tiles     %8.3f s  %-6s  %lld segments  checksum %.6g\n",
+			   setup, loaded ? "mapped" : "built", sink.segments, sink.checksum);
+	}
+
+	for (int run = 0; run < 2; ++run)
+	{
+		AdaptiveMarchingSquares adaptive;
+
+		start = PerfCounters::now();
+		const bool loaded = adaptive.setGridView(view, 8, "bench_pyramid.msix");
+		const double setup = PerfCounters::now() - start;
+
+		adaptive.computeIsolines(0.5f, 0.002f);
+
+		printf("pyramid          %8.3f s  %-6s  %lu segments\n",
+			   setup, loaded ? "mapped" : "built", static_cast<unsigned long>(adaptive.getIsolineVertexList()->size()/2));
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchCache(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	// 256x256 cell tiles requested round-robin, as a tile server would
+	static const int TILE = 256;
+	const int tilesX = (width - 1)/TILE;
+	const int tilesY = (height - 1)/TILE;
+	const GridView whole = GridView::whole(&heights[0], width, height);
+
+	IsolineCache cache(64ull << 20);
+	MarchingSquares marchingSquares;
+
+	for (int pass = 0; pass < 3; ++pass)
+	{
+		const double start = PerfCounters::now();
+		size_t segments = 0;
+
+		for (int t = 0; t < tilesX*tilesY; ++t)
+		{
+			marchingSquares.setGridView(whole.subView((t % tilesX)*TILE, (t / tilesX)*TILE, TILE + 1, TILE + 1));
+			segments += cache.computeIsolines(marchingSquares, 0.5f).size()/4;
+		}
+
+		const double seconds = PerfCounters::now() - start;
+		printf("pass %d  %5d tiles  %8.1f us/tile  %lu segments\n", pass, tilesX*tilesY,
+			   seconds*1e6/std::max(tilesX*tilesY, 1), static_cast<unsigned long>(segments));
+	}
+
+	cache.getStats().report(stdout);
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchLevels(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+
+	GridAnalysis analysis;
+	double start = PerfCounters::now();
+	analysis.analyze(marchingSquares.getGridView(), 1024);
+	printf("analysis         %8.3f s  range [%g, %g]\n", PerfCounters::now() - start, analysis.getMin(), analysis.getMax());
+
+	static const char* names[2] = { "equal", "quantile" };
+
+	for (int spacing = 0; spacing < 2; ++spacing)
+	{
+		const std::vector<float> levels = analysis.levels(5, static_cast<GridAnalysis::LevelSpacing>(spacing));
+
+		for (size_t k = 0; k < levels.size(); ++k)
+		{
+			// output sized from the prediction before extracting (exact, see benchmark check)
+			std::vector<float> segments;
+			segments.reserve(4*static_cast<size_t>(analysis.predictSegments(levels[k])));
+
+			SegmentBufferSink sink(segments);
+			start = PerfCounters::now();
+			marchingSquares.computeIsolines(levels[k], sink);
+
+			printf("%-8s %.5f %8.3f s  %9lu segments\n", names[spacing], levels[k], PerfCounters::now() - start,
+				   static_cast<unsigned long>(segments.size()/4));
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchSharded(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	const GridView view = GridView::whole(&heights[0], width, height);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setGridView(view);
+
+	std::vector<float> reference;
+	SegmentBufferSink sink(reference);
+	double start = PerfCounters::now();
+	marchingSquares.computeIsolines(0.5f, sink);
+	printf("1 process        %8.3f s  %lu segments\n", PerfCounters::now() - start, static_cast<unsigned long>(reference.size()/4));
+
+	static const int workers[3] = { 1, 2, 4 };
+
+	for (int k = 0; k < 3; ++k)
+	{
+		ShardedExtractor extractor;
+		extractor.setWorkers(workers[k]);
+
+		std::vector<float> segments;
+		start = PerfCounters::now();
+		const bool ok = extractor.computeIsolines(view, 0.5f, segments);
+
+		printf("%d workers        %8.3f s  %lu segments, %d bands%s\n", workers[k], PerfCounters::now() - start,
+			   static_cast<unsigned long>(segments.size()/4), extractor.getBands(),
+			   !ok ? "  (failed)" : (segments == reference ? "" : "  (differs)"));
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchFixed(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	static const int sizes[2] = { 257, 513 };
+	static const char* names[2] = { "generic", "fixed" };
+
+	for (int s = 0; s < 2; ++s)
+	{
+		// packed tiles of 256/512 cells, as a tile pipeline would hold them
+		const int size = sizes[s];
+		const int tilesX = (width - 1)/(size - 1);
+		const int tilesY = (height - 1)/(size - 1);
+		std::vector<float> tile(static_cast<size_t>(size)*size);
+
+		for (int kernel = 0; kernel < 2; ++kernel)
+		{
+			MarchingSquares marchingSquares;
+			marchingSquares.setKernel(kernel ? MarchingSquares::KERNEL_SCALAR : MarchingSquares::KERNEL_GENERIC);
+
+			ChecksumSink sink;
+			double seconds = 0.0;
+
+			for (int t = 0; t < tilesX*tilesY; ++t)
+			{
+				const int x0 = (t % tilesX)*(size - 1);
+				const int y0 = (t / tilesX)*(size - 1);
+
+				for (int y = 0; y < size; ++y)
+					memcpy(&tile[static_cast<size_t>(y)*size], &heights[static_cast<size_t>(y0 + y)*width + x0], size*sizeof(float));
+
+				GridView view = GridView::whole(&tile[0], size, size);
+				view.originX = x0;
+				view.originY = y0;
+				marchingSquares.setGridView(view);
+
+				const double start = PerfCounters::now();
+				marchingSquares.computeIsolines(0.5f, sink);
+				seconds += PerfCounters::now() - start;
+			}
+
+			printf("%dx%d %-8s %5d tiles %8.3f s  %7.2f ns/cell  %lld segments  checksum %.6g\n", size - 1, size - 1, names[kernel],
+				   tilesX*tilesY, seconds, seconds*1e9/(static_cast<double>(tilesX)*tilesY*(size - 1)*(size - 1)), sink.segments, sink.checksum);
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchSpatial(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+
+	std::vector<float> segments;
+	SegmentBufferSink buffer(segments);
+	double start = PerfCounters::now();
+	marchingSquares.computeIsolines(0.5f, buffer);
+	const double plain = PerfCounters::now() - start;
+	printf("extraction       %8.3f s  %lu segments\n", plain, static_cast<unsigned long>(segments.size()/4));
+
+	segments.clear();
+	SegmentIndex index;
+	index.reset(0, 0, width - 1, height - 1);
+	SinkPair<SegmentBufferSink, SegmentIndex> pair(buffer, index);
+	start = PerfCounters::now();
+	marchingSquares.computeIsolines(0.5f, pair);
+	index.finalize();
+	const double indexed = PerfCounters::now() - start;
+	printf("with index       %8.3f s  (+%.1f%%)  %.1f MB\n", indexed, 100.0*(indexed - plain)/plain, index.getMemoryUsage()/1e6);
+
+	// random probes, against a linear scan of the segments
+	static const int QUERIES = 2000;
+	unsigned int seed = 777u;
+	std::vector<float> px(QUERIES), py(QUERIES);
+
+	for (int q = 0; q < QUERIES; ++q)
+	{
+		seed = seed*1664525u + 1013904223u;
+		px[q] = (seed >> 8)/16777216.0f*(width - 1);
+		seed = seed*1664525u + 1013904223u;
+		py[q] = (seed >> 8)/16777216.0f*(height - 1);
+	}
+
+	double checksum = 0.0;
+	start = PerfCounters::now();
+
+	for (int q = 0; q < QUERIES; ++q)
+	{
+		float distance;
+		index.nearest(px[q], py[q], distance);
+		checksum += distance;
+	}
+
+	printf("nearest indexed  %8.3f us/query  checksum %.6g\n", (PerfCounters::now() - start)*1e6/QUERIES, checksum);
+
+	checksum = 0.0;
+	start = PerfCounters::now();
+
+	for (int q = 0; q < QUERIES/100; ++q)
+	{
+		float best = 1e30f;
+
+		for (size_t k = 0; k < segments.size(); k += 4)
+		{
+			const float dx = segments[k+2] - segments[k];
+			const float dy = segments[k+3] - segments[k+1];
+			const float length2 = dx*dx + dy*dy;
+			float t = (length2 > 0.0f) ? ((px[q] - segments[k])*dx + (py[q] - segments[k+1])*dy)/length2 : 0.0f;
+			t = std::min(std::max(t, 0.0f), 1.0f);
+			const float ex = segments[k] + t*dx - px[q];
+			const float ey = segments[k+1] + t*dy - py[q];
+			best = std::min(best, ex*ex + ey*ey);
+		}
+
+		checksum += sqrtf(best);
+	}
+
+	printf("nearest scan     %8.3f us/query  (first %d queries, checksum %.6g)\n",
+		   (PerfCounters::now() - start)*1e6/(QUERIES/100), QUERIES/100, checksum);
+
+	std::vector<int> hits;
+	long long found = 0;
+	start = PerfCounters::now();
+
+	for (int q = 0; q < QUERIES; ++q)
+	{
+		index.query(px[q], py[q], px[q] + 64.0f, py[q] + 64.0f, hits);
+		found += hits.size();
+	}
+
+	printf("64x64 rectangle  %8.3f us/query  %.1f segments/query\n", (PerfCounters::now() - start)*1e6/QUERIES, double(found)/QUERIES);
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchRelief(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	const GridView view = GridView::whole(&heights[0], width, height);
+	std::vector<unsigned char> reference;
+
+	static const int threads[3] = { 1, 2, 4 };
+
+	for (int k = 0; k < 3; ++k)
+	{
+		ReliefRaster relief;
+		relief.setZFactor(200.0f);
+		relief.setThreads(threads[k]);
+
+		double start = PerfCounters::now();
+		relief.update(view);
+		const double render = PerfCounters::now() - start;
+
+		start = PerfCounters::now();
+		const bool rendered = relief.update(view);
+		const double unchanged = PerfCounters::now() - start;
+
+		const std::vector<unsigned char> pixels(relief.getPixels(), relief.getPixels() + 4*static_cast<size_t>(width)*height);
+
+		if (k == 0)
+			reference = pixels;
+
+		printf("%d threads        %8.3f s  %6.1f Mpixels/s  unchanged update %.3f s%s%s\n", threads[k], render,
+			   width*static_cast<double>(height)/(render*1e6), unchanged, rendered ? "  (rendered again)" : "",
+			   pixels == reference ? "" : "  (differs)");
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchSpill(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+
+	// a busy map at many levels
+	static const int LEVELS = 32;
+	static const size_t budgets[3] = { 0, 64u << 20, 8u << 20 };
+
+	for (int k = 0; k < 3; ++k)
+	{
+		SegmentStore store(budgets[k]);
+
+		double start = PerfCounters::now();
+
+		for (int l = 0; l < LEVELS; ++l)
+			marchingSquares.computeIsolines((l + 0.5f)/LEVELS, store);
+
+		const bool ok = store.finish();
+		const double extraction = PerfCounters::now() - start;
+
+		// read everything back
+		SegmentStore::Reader reader(store);
+		const float* segments;
+		int count;
+		float level;
+		double checksum = 0.0;
+		start = PerfCounters::now();
+
+		while (reader.next(segments, count, level))
+			for (int i = 0; i < 4*count; ++i)
+				checksum += segments[i]*level;
+
+		const double reading = PerfCounters::now() - start;
+
+		printf("budget %4lu MB   %8.3f s  read %.3f s  %lu segments  peak %6.1f MB  spilled %6.1f MB  checksum %.10g%s\n",
+			   static_cast<unsigned long>(budgets[k] >> 20), extraction, reading, static_cast<unsigned long>(store.size()),
+			   store.getPeakMemoryUsage()/1e6, store.getSpilledBytes()/1e6, checksum, ok ? "" : "  (spill failed)");
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchStats(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+
+	static const int LEVELS = 64;
+	std::vector<float> levels(LEVELS);
+
+	for (int l = 0; l < LEVELS; ++l)
+		levels[l] = (l + 0.5f)/LEVELS;
+
+	// segments and length through the extraction, one pass per level;
+	// benchmark check compares the two
+	std::vector<SegmentCounter> counters(LEVELS);
+	double start = PerfCounters::now();
+
+	for (int l = 0; l < LEVELS; ++l)
+		marchingSquares.computeIsolines(levels[l], counters[l]);
+
+	printf("extraction       %8.3f s  %d levels\n", PerfCounters::now() - start, LEVELS);
+
+	static const int threads[3] = { 1, 2, 4 };
+
+	for (int k = 0; k < 3; ++k)
+	{
+		ContourStatistics statistics;
+		statistics.setThreads(threads[k]);
+
+		start = PerfCounters::now();
+		statistics.compute(marchingSquares.getGridView(), levels);
+		printf("statistics %d thr %8.3f s  %d levels\n", threads[k], PerfCounters::now() - start, LEVELS);
+	}
+
+	ContourStatistics statistics;
+	statistics.compute(marchingSquares.getGridView(), levels);
+
+	// hypsometric curve: fraction of the map above each level
+	for (int l = 0; l < LEVELS; l += LEVELS/8)
+		printf("  above %.4f  %5.1f%%  length %10.0f\n", statistics.get(l).level,
+			   100.0*statistics.get(l).area/statistics.getCellCount(), statistics.get(l).length);
+}
+
+
+//-----------------------------------------------------------------------------
+static void benchSupersample(const int width, const int height)
+{
+	std::vector<float> heights;
+	makeTerrain(heights, width, height, 0.02f);
+
+	const GridView view = GridView::whole(&heights[0], width, height);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(width, height, &heights[0]);
+
+	SegmentCounter plain;
+	double start = PerfCounters::now();
+	marchingSquares.computeIsolines(0.5f, plain);
+	printf("coarse            %8.3f s  %9lld segments  length %.1f\n", PerfCounters::now() - start, plain.segments, plain.length);
+
+	SupersampledGrid supersampled;
+	supersampled.setGridView(view);
+
+	static const int factors[3] = { 1, 4, 8 };
+	static const char* names[2] = { "bilinear", "bicubic" };
+
+	for (int f = 0; f < 3; ++f)
+	{
+		const int k = factors[f];
+		supersampled.setFactor(k);
+
+		for (int m = 0; m < 2; ++m)
+		{
+			supersampled.setInterpolation(static_cast<SupersampledGrid::Interpolation>(m));
+
+			SegmentCounter counter;
+			start = PerfCounters::now();
+			supersampled.computeIsolines(0.5f, counter);
+			const double elapsed = PerfCounters::now() - start;
+
+			printf("%-8s x%d       %8.3f s  %9lld segments  length %.1f  %lld cells refined\n", names[m], k, elapsed,
+				   counter.segments, counter.length, supersampled.getRefinedCells());
+		}
+
+		// the same field upsampled in memory, the way it was done before
+		const int w = (width - 1)*k + 1;
+		const int h = (height - 1)*k + 1;
+		std::vector<float> upsampled(static_cast<size_t>(w)*h);
+		std::vector<float> cell(static_cast<size_t>(k + 1)*(k + 1));
+
+		supersampled.setInterpolation(SupersampledGrid::INTERPOLATION_BILINEAR);
+		start = PerfCounters::now();
+
+		for (int y = 0; y < height - 1; ++y)
+		{
+			for (int x = 0; x < width - 1; ++x)
+			{
+				supersampled.sampleCell(x, y, &cell[0]);
+
+				for (int j = 0; j <= k; ++j)
+					std::copy(&cell[j*(k + 1)], &cell[j*(k + 1)] + k + 1, &upsampled[static_cast<size_t>(y*k + j)*w + x*k]);
+			}
+		}
+
+		MarchingSquares fine;
+		fine.setHeightMap(w, h, &upsampled[0]);
+
+		SegmentCounter counter;
+		fine.computeIsolines(0.5f, counter);
+
+		printf("materialized x%d   %8.3f s  %9lld segments  length %.1f  %.1f MB\n", k, PerfCounters::now() - start,
+			   counter.segments, counter.length/k, upsampled.size()*sizeof(float)/1e6);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+static int checkFailures = 0;
+
+static void expect(const bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED  %s\n", what);
+		++checkFailures;
+	}
+}
+
+
+// views narrower or shorter than one cell, through every kernel and tiling
+static void checkDegenerateViews()
+{
+	static const int sizes[5][2] = { { 1, 8 }, { 8, 1 }, { 1, 1 }, { 2, 2 }, { 3, 2 } };
+	const float samples[8] = { 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f };
+
+	for (int s = 0; s < 5; ++s)
+	{
+		const int w = sizes[s][0];
+		const int h = sizes[s][1];
+		const long long expected = (w < 2 || h < 2) ? 0 : w - 1;
+
+		for (int tiling = 0; tiling < 3; ++tiling)
+		{
+			for (int kernel = 0; kernel < 3; ++kernel)
+			{
+				std::vector<float> data(samples, samples + w*h);
+				MarchingSquares marchingSquares;
+				marchingSquares.setTiling(static_cast<MarchingSquares::Tiling>(tiling));
+				marchingSquares.setKernel(static_cast<MarchingSquares::Kernel>(kernel));
+				marchingSquares.setHeightMap(w, h, &data[0]);
+
+				SegmentCounter counter;
+				marchingSquares.computeIsolines(0.5f, counter);
+				expect(counter.segments == expected, "degenerate view: segment count");
+			}
+		}
+
+		// profiled path, into the vertex list
+		std::vector<float> data(samples, samples + w*h);
+		MarchingSquares marchingSquares;
+		marchingSquares.setProfiling(true);
+		marchingSquares.setHeightMap(w, h, &data[0]);
+		marchingSquares.computeIsolines(0.5f);
+		expect(marchingSquares.getProfile().segments == expected, "degenerate view: profiled segment count");
+		expect(static_cast<long long>(marchingSquares.getIsolineVertexList()->size()) == 2*expected, "degenerate view: profiled vertex list");
+	}
+}
+
+
+// non-finite heights are drawn transparent, everything else opaque
+static void checkReliefNonFinite()
+{
+	std::vector<float> heights(64);
+
+	for (int k = 0; k < 64; ++k)
+		heights[k] = (k % 8)*0.1f + (k / 8)*0.05f;
+
+	heights[9] = sqrtf(-1.0f);
+	heights[27] = HUGE_VALF;
+	heights[63] = -HUGE_VALF;
+
+	for (int colormap = 0; colormap < 2; ++colormap)
+	{
+		ReliefRaster relief;
+		relief.setColormap(static_cast<ReliefRaster::Colormap>(colormap));
+		relief.setZFactor(4.0f);
+		relief.update(GridView::whole(&heights[0], 8, 8));
+
+		for (int k = 0; k < 64; ++k)
+		{
+			const bool finite = heights[k] - heights[k] == 0.0f;
+			expect(relief.getPixels()[4*k + 3] == (finite ? 255 : 0), "relief: alpha of non-finite heights");
+		}
+	}
+}
+
+
+// invalid band sizes are rejected, valid ones reproduce the serial output
+static void checkShardedBandRows()
+{
+#ifndef _WIN32
+	std::vector<float> heights;
+	makeTerrain(heights, 97, 61, 0.02f);
+	const GridView view = GridView::whole(&heights[0], 97, 61);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setGridView(view);
+
+	std::vector<float> serial;
+	SegmentBufferSink sink(serial);
+	marchingSquares.computeIsolines(0.5f, sink);
+
+	ShardedExtractor sharded;
+	sharded.setWorkers(2);
+
+	expect(!sharded.setBandRows(0) && sharded.getBandRows() > 0, "sharded: band rows 0 rejected");
+	expect(!sharded.setBandRows(-3) && sharded.getBandRows() > 0, "sharded: negative band rows rejected");
+
+	static const int rows[4] = { 0, 1, 7, 1000 };
+
+	for (int k = 0; k < 4; ++k)
+	{
+		sharded.setBandRows(rows[k]);
+
+		std::vector<float> segments;
+		expect(sharded.computeIsolines(view, 0.5f, segments), "sharded: extraction succeeds");
+		expect(segments == serial, "sharded: output equals serial extraction");
+	}
+
+	// strided region read in place by the workers
+	const GridView region = view.subView(5, 3, 80, 50);
+	marchingSquares.setGridView(region);
+	serial.clear();
+	marchingSquares.computeIsolines(0.5f, sink);
+
+	sharded.setBandRows(7);
+	std::vector<float> segments;
+	expect(sharded.computeIsolines(region, 0.5f, segments) && segments == serial, "sharded: region equals serial extraction");
+
+	// workers that miss the deadline are replaced, their bands computed
+	// here (how many do depends on scheduling, the output does not)
+	sharded.setBandTimeout(0);
+	sharded.setMaxRestarts(1000);
+	expect(sharded.computeIsolines(region, 0.5f, segments) && segments == serial, "sharded: timed out bands computed in process");
+	expect(sharded.getTimeouts() <= sharded.getBands(), "sharded: at most one timeout per band");
+#endif
+}
+
+
+// huge coordinates across buffer flushes, non-finite coordinates and levels
+static void checkExportNumbers()
+{
+	const char* filename = "check_export.geojson";
+
+	GeoJSONWriter writer;
+	writer.setTransform(CoordinateTransform(0.0, 0.0, 1e300, -1e300));
+	writer.setPrecision(6);
+	expect(writer.open(filename), "export: open");
+
+	const float nan = sqrtf(-1.0f);
+	static const int SEGMENTS = 5000;
+
+	writer.beginLevel(nan);
+
+	for (int k = 0; k < SEGMENTS; ++k)
+		writer.segment(1.0f + k, 2.0f, 3.0f, 4.0f + k);
+
+	writer.segment(nan, 1.0f, 2.0f, 3.0f);
+	writer.segment(1.0f, 2.0f, HUGE_VALF, 3.0f);
+	writer.endLevel();
+
+	expect(writer.close(), "export: close");
+	expect(writer.getSkippedSegments() == 2, "export: non-finite segments skipped");
+
+	std::ifstream file(filename, std::ios::binary);
+	const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	remove(filename);
+
+	expect(text.size() == writer.getBytesWritten(), "export: bytes written");
+	expect(text.find("nan") == std::string::npos && text.find("inf") == std::string::npos, "export: no nan/inf in JSON");
+	expect(text.find("\"level\":null") != std::string::npos, "export: NaN level written as null");
+	expect(text.size() > 4u*SEGMENTS*300u, "export: large coordinates written in full");
+	expect(text.size() > 3 && text.compare(text.size() - 3, 3, "]}\n") == 0, "export: footer");
+
+	// shortest text keeps transformed coordinates in double precision
+	const CoordinateTransform transform(1000000.1, -0.7, 1.0/3.0, 1e-9);
+
+	GeoJSONWriter shortest;
+	shortest.setTransform(transform);
+	shortest.setPrecision(-1);
+	expect(shortest.open(filename), "export: open shortest");
+	shortest.beginLevel(0.3f);
+	shortest.segment(1.0f, 2.0f, 3.0f, 4.0f);
+	shortest.endLevel();
+	expect(shortest.close(), "export: close shortest");
+
+	std::ifstream shortestFile(filename, std::ios::binary);
+	const std::string shortestText((std::istreambuf_iterator<char>(shortestFile)), std::istreambuf_iterator<char>());
+	shortestFile.close();
+	remove(filename);
+
+	const size_t start = shortestText.find("[[[");
+	double p[4] = { 0.0, 0.0, 0.0, 0.0 };
+	expect(start != std::string::npos && sscanf(shortestText.c_str() + start, "[[[%lf,%lf],[%lf,%lf]]]", &p[0], &p[1], &p[2], &p[3]) == 4, "export: shortest coordinates parse");
+	expect(p[0] == transform.x(1.0f) && p[1] == transform.y(2.0f) && p[2] == transform.x(3.0f) && p[3] == transform.y(4.0f), "export: shortest coordinates read back exactly");
+	expect(shortestText.find("\"level\":0.3}") != std::string::npos, "export: level written as the shortest float");
+}
+
+
+// cursors that do not belong to the grid and thresholds are rejected
+static void checkCursorValidation()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 9, 7, 0.02f);
+
+	const ms_grid_view grid = { &heights[0], 9, 7, 9, 0, 0 };
+	const float thresholds[2] = { 0.45f, 0.55f };
+	ms_segment out[4];
+	size_t written;
+
+	static const int cursors[8][4] =
+	{
+		{ -1, 0, 0, 0 }, { 3, 0, 0, 0 }, { 0, -1, 0, 0 }, { 0, 9, 0, 0 },
+		{ 0, 0, -5, 0 }, { 0, 0, 7, 0 }, { 0, 0, 0, -1 }, { 0, 0, 0, 3 }
+	};
+
+	for (int k = 0; k < 8; ++k)
+	{
+		ms_cursor cursor = { cursors[k][0], cursors[k][1], cursors[k][2], cursors[k][3] };
+		expect(ms_extract_segments(&grid, thresholds, 2, out, 4, &cursor, &written) == MS_EINVAL, "C API: invalid cursor rejected");
+	}
+
+	// a valid cursor still runs to the end, in small pieces
+	size_t expected = 0, total = 0;
+	ms_count_segments(&grid, thresholds, 2, &expected);
+
+	ms_cursor cursor;
+	ms_cursor_reset(&cursor);
+	int status;
+
+	do
+	{
+		status = ms_extract_segments(&grid, thresholds, 2, out, 4, &cursor, &written);
+		total += written;
+	}
+	while (status == MS_MORE);
+
+	expect(status == MS_OK && total == expected, "C API: resumed extraction complete");
+	expect(ms_extract_segments(&grid, thresholds, 2, out, 4, &cursor, &written) == MS_OK && written == 0, "C API: finished cursor");
+}
+
+
+#ifndef _WIN32
+static int countFiles(const char* directory)
+{
+	DIR* dir = opendir(directory);
+	int count = 0;
+
+	if (dir == NULL)
+		return -1;
+
+	while (dirent* entry = readdir(dir))
+		count += entry->d_name[0] != '.';
+
+	closedir(dir);
+	return count;
+}
+#endif
+
+
+// spill files stay within the disk budget and are removed with the cache;
+// results of different extraction options do not mix
+static void checkCacheSpill()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 257, 129, 0.02f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(257, 129, &heights[0]);
+
+#ifndef _WIN32
+	char directory[] = "/tmp/cache_check_XXXXXX";
+	expect(mkdtemp(directory) != NULL, "cache: temporary directory");
+
+	{
+		IsolineCache cache(1, 0);
+		cache.setSpillDirectory(directory);
+
+		// room for about three spilled results
+		const std::vector<float>& first = cache.computeIsolines(marchingSquares, 0.5f);
+		const unsigned long long fileBytes = first.size()*sizeof(float) + 64;
+		cache.setMaxDiskBytes(3*fileBytes);
+
+		std::vector<float> reference = first;
+
+		for (int k = 1; k <= 20; ++k)
+		{
+			cache.computeIsolines(marchingSquares, 0.5f + k*0.001f);
+			expect(cache.getStats().diskBytes <= cache.getMaxDiskBytes(), "cache: disk budget kept");
+			expect(countFiles(directory) == cache.getStats().diskEntries, "cache: one file per disk entry");
+		}
+
+		expect(cache.getStats().diskEvictions > 0, "cache: disk evictions");
+
+		// the most recent spill is read back and its file deleted
+		const long long diskHits = cache.getStats().diskHits;
+		const long long onDisk = cache.getStats().diskEntries;
+		cache.computeIsolines(marchingSquares, 0.5f + 19*0.001f);
+		expect(cache.getStats().diskHits == diskHits + 1, "cache: disk hit");
+		expect(cache.getStats().diskEntries <= onDisk, "cache: file of a disk hit deleted");
+
+		// an option that changes the output order is a different entry
+		const long long misses = cache.getStats().misses;
+		marchingSquares.setTiling(MarchingSquares::TILING_MORTON);
+		cache.computeIsolines(marchingSquares, 0.5f);
+		expect(cache.getStats().misses == misses + 1, "cache: options are part of the key");
+		marchingSquares.setTiling(MarchingSquares::TILING_NONE);
+
+		expect(cache.computeIsolines(marchingSquares, 0.5f) == reference, "cache: result for the same options");
+	}
+
+	expect(countFiles(directory) == 0, "cache: spill files removed with the cache");
+
+	// a spill file whose count disagrees with its size is a miss, not an allocation
+	{
+		IsolineCache cache(1, 1ull << 30);
+		cache.setSpillDirectory(directory);
+
+		const std::vector<float> reference = cache.computeIsolines(marchingSquares, 0.6f);
+		cache.computeIsolines(marchingSquares, 0.61f);
+		expect(countFiles(directory) == 1, "cache: evicted result spilled");
+
+		DIR* dir = opendir(directory);
+
+		while (dirent* entry = (dir != NULL) ? readdir(dir) : NULL)
+		{
+			if (entry->d_name[0] == '.')
+				continue;
+
+			const std::string path = std::string(directory) + "/" + entry->d_name;
+			const uint64_t count = 1ull << 60;
+			FILE* file = fopen(path.c_str(), "r+b");
+			expect(file != NULL && fseek(file, 4 + sizeof(IsolineCache::Key), SEEK_SET) == 0
+				   && fwrite(&count, sizeof(count), 1, file) == 1 && fclose(file) == 0, "cache: spill file rewritten");
+		}
+
+		if (dir != NULL)
+			closedir(dir);
+
+		const long long diskHits = cache.getStats().diskHits;
+		const long long misses = cache.getStats().misses;
+		expect(cache.computeIsolines(marchingSquares, 0.6f) == reference, "cache: corrupt spill recomputed");
+		expect(cache.getStats().diskHits == diskHits && cache.getStats().misses == misses + 1, "cache: corrupt spill is a miss");
+	}
+
+	expect(countFiles(directory) == 0, "cache: spill files removed with the cache");
+	rmdir(directory);
+#endif
+}
+
+
+//
+static void sortedVertices(const std::list< Vec2<float> >& vertexList, std::vector< std::pair<float, float> >& out)
+{
+	out.clear();
+
+	for (std::list< Vec2<float> >::const_iterator it = vertexList.begin(); it != vertexList.end(); ++it)
+		out.push_back(std::make_pair(it->x(), it->y()));
+
+	std::sort(out.begin(), out.end());
+}
+
+
+//
+static bool writeBytes(const char* filename, const std::vector<char>& bytes, const size_t size)
+{
+	FILE* file = fopen(filename, "wb");
+
+	if (file == NULL)
+		return false;
+
+	const bool ok = fwrite(&bytes[0], 1, size, file) == size;
+	return (fclose(file) == 0) && ok;
+}
+
+
+//
+static void checkChunkedHeightMap()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 131, 97, 0.02f);
+	const GridView view = GridView::whole(&heights[0], 131, 97).subView(9, 5, 100, 70);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setGridView(view);
+	marchingSquares.computeIsolines(0.6f);
+
+	std::vector< std::pair<float, float> > serial, chunked;
+	sortedVertices(*marchingSquares.getIsolineVertexList(), serial);
+	expect(!serial.empty(), "chunked: the level crosses the subview");
+
+	const char* filename = "chunk_check.msh";
+	expect(ChunkedHeightMap::write(filename, view, 32), "chunked: write subview");
+
+	// the subview comes back in its parent's frame
+	ChunkedHeightMap map;
+	std::list< Vec2<float> > vertexList;
+	expect(map.open(filename), "chunked: open");
+	expect(map.getOriginX() == 9 && map.getOriginY() == 5, "chunked: origin stored");
+	expect(map.computeIsolines(0.6f, vertexList) > 0, "chunked: extraction succeeds");
+	sortedVertices(vertexList, chunked);
+	expect(chunked == serial, "chunked: output equals the subview's");
+	map.close();
+
+	std::vector<char> bytes;
+	{
+		std::ifstream in(filename, std::ios::binary);
+		bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	const char* damaged = "chunk_damaged.msh";
+	const size_t header = sizeof(ChunkFileHeader);
+	const size_t truncated[5] = { 0, 12, header, header + 2*sizeof(ChunkRecord), bytes.size() - 1 };
+
+	for (int k = 0; k < 5; ++k)
+	{
+		writeBytes(damaged, bytes, truncated[k]);
+		expect(!map.open(damaged), "chunked: truncated file rejected");
+	}
+
+	// chunk grid, payload offset and payload size out of line with the file
+	const size_t fields[3] = { offsetof(ChunkFileHeader, chunksX), header + offsetof(ChunkRecord, offset), header + offsetof(ChunkRecord, byteSize) };
+
+	for (int k = 0; k < 3; ++k)
+	{
+		std::vector<char> corrupt = bytes;
+		uint32_t value;
+		memcpy(&value, &corrupt[fields[k]], sizeof(value));
+		value += (k == 0) ? 1 : static_cast<uint32_t>(bytes.size());
+		memcpy(&corrupt[fields[k]], &value, sizeof(value));
+
+		writeBytes(damaged, corrupt, corrupt.size());
+		expect(!map.open(damaged), "chunked: corrupt header rejected");
+	}
+
+	expect(map.open(filename), "chunked: reopen after a failed open");
+
+	remove(filename);
+	remove(damaged);
+}
+
+
+// new samples through setData() are contoured with their own tile bounds
+static void checkSetData()
+{
+	std::vector<float> first, second;
+	makeTerrain(first, 200, 150, 0.02f);
+	makeTerrain(second, 200, 150, 0.02f);
+
+	// the second map only crosses the level where the first one does not
+	for (size_t k = 0; k < second.size(); ++k)
+		second[k] = (k % 200 < 100) ? second[k] + 1.0f : second[k];
+
+	for (int tiling = 0; tiling < 3; ++tiling)
+	{
+		MarchingSquares fresh;
+		fresh.setTiling(static_cast<MarchingSquares::Tiling>(tiling));
+		fresh.setHeightMap(200, 150, &second[0]);
+
+		std::vector<float> reference;
+		SegmentBufferSink referenceSink(reference);
+		fresh.computeIsolines(1.55f, referenceSink);
+		expect(!reference.empty(), "setData: the level crosses the new map");
+
+		MarchingSquares marchingSquares;
+		marchingSquares.setTiling(static_cast<MarchingSquares::Tiling>(tiling));
+		marchingSquares.setHeightMap(200, 150, &first[0]);
+		marchingSquares.setData(&second[0]);
+
+		std::vector<float> segments;
+		SegmentBufferSink sink(segments);
+		marchingSquares.computeIsolines(1.55f, sink);
+		expect(segments == reference, "setData: output equals a fresh extractor's");
+	}
+}
+
+
+// a tile index whose hash matches but whose sections are damaged is rebuilt
+static void checkTileIndex()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 300, 200, 0.02f);
+	const GridView view = GridView::whole(&heights[0], 300, 200);
+	const char* filename = "tile_check.msix";
+
+	for (int tiling = MarchingSquares::TILING_BLOCKED; tiling <= MarchingSquares::TILING_MORTON; ++tiling)
+	{
+		remove(filename);
+
+		MarchingSquares marchingSquares;
+		marchingSquares.setTiling(static_cast<MarchingSquares::Tiling>(tiling));
+		expect(!marchingSquares.setGridView(view, filename), "tile index: built");
+
+		std::vector<float> reference;
+		SegmentBufferSink referenceSink(reference);
+		marchingSquares.computeIsolines(0.55f, referenceSink);
+
+		std::vector<char> bytes;
+		{
+			std::ifstream in(filename, std::ios::binary);
+			bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+
+		// section records follow the 32-byte header, 24 bytes each: id, reserved, offset, size;
+		// the order is the third section
+		uint64_t orderOffset;
+		memcpy(&orderOffset, &bytes[32 + 2*24 + 8], sizeof(orderOffset));
+		expect(orderOffset + sizeof(int) <= bytes.size(), "tile index: order section");
+
+		for (int damage = 0; damage < 3; ++damage)
+		{
+			std::vector<char> corrupt = bytes;
+
+			if (damage == 2)
+			{
+				// misaligned section
+				const uint64_t offset = orderOffset - 1;
+				memcpy(&corrupt[32 + 2*24 + 8], &offset, sizeof(offset));
+			}
+			else
+			{
+				// an entry out of range, or a tile listed twice
+				int entry = (damage == 0) ? 1 << 30 : 0;
+				int first;
+				memcpy(&first, &corrupt[orderOffset], sizeof(first));
+				memcpy(&corrupt[orderOffset + sizeof(int)], damage == 0 ? &entry : &first, sizeof(int));
+			}
+
+			writeBytes(filename, corrupt, corrupt.size());
+
+			MarchingSquares reloaded;
+			reloaded.setTiling(static_cast<MarchingSquares::Tiling>(tiling));
+			expect(!reloaded.setGridView(view, filename), "tile index: damaged file rebuilt");
+
+			std::vector<float> segments;
+			SegmentBufferSink sink(segments);
+			reloaded.computeIsolines(0.55f, sink);
+			expect(segments == reference, "tile index: output after rebuild");
+		}
+
+		MarchingSquares mapped;
+		mapped.setTiling(static_cast<MarchingSquares::Tiling>(tiling));
+		expect(mapped.setGridView(view, filename), "tile index: rewritten file mapped");
+	}
+
+	remove(filename);
+}
+
+
+// end points shared by two segments, except where lines leave the view
+static int openEnds(const std::vector<float>& segments, const float xMin, const float yMin, const float xMax, const float yMax)
+{
+	std::vector< std::pair<float, float> > ends;
+
+	for (size_t k = 0; k < segments.size(); k += 2)
+		ends.push_back(std::make_pair(segments[k], segments[k+1]));
+
+	std::sort(ends.begin(), ends.end());
+
+	int open = 0;
+
+	for (size_t k = 0; k < ends.size(); )
+	{
+		size_t next = k;
+
+		while (next < ends.size() && ends[next] == ends[k])
+			++next;
+
+		const bool border = ends[k].first == xMin || ends[k].first == xMax || ends[k].second == yMin || ends[k].second == yMax;
+		open += !border && (next - k) % 2 != 0;
+		k = next;
+	}
+
+	return open;
+}
+
+
+// a negative tolerance refines to single cells: the exact extraction
+static void checkAdaptiveExact()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 160, 110, 0.02f);
+	const GridView view = GridView::whole(&heights[0], 160, 110).subView(3, 4, 150, 97);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setGridView(view);
+	marchingSquares.computeIsolines(0.55f);
+
+	std::vector< std::pair<float, float> > exact, refined;
+	sortedVertices(*marchingSquares.getIsolineVertexList(), exact);
+	expect(!exact.empty(), "adaptive: the level crosses the view");
+
+	AdaptiveMarchingSquares adaptive;
+	adaptive.setGridView(view, 5);
+	adaptive.computeIsolines(0.55f, -1.0f);
+	sortedVertices(*adaptive.getIsolineVertexList(), refined);
+
+	expect(adaptive.getCoarseCells() == 0, "adaptive: no coarse cells below zero tolerance");
+	expect(refined == exact, "adaptive: output equals computeIsolines");
+}
+
+
+// coarse cells next to finer ones cross shared edges at the same points
+static void checkAdaptiveStitched()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 300, 200, 0.0f);
+
+	// a noisy patch keeps the cells around it fine
+	for (int y = 80; y < 120; ++y)
+		for (int x = 100; x < 160; ++x)
+			heights[y*300 + x] += 0.02f*sinf(x*1.7f + y*2.3f);
+
+	const GridView view = GridView::whole(&heights[0], 300, 200).subView(2, 3, 290, 190);
+
+	AdaptiveMarchingSquares adaptive;
+	adaptive.setGridView(view, 5);
+
+	static const float thresholds[3] = { 0.52f, 0.6f, 0.67f };
+	long long coarse = 0;
+
+	for (int k = 0; k < 3; ++k)
+	{
+		adaptive.computeIsolines(thresholds[k], 0.002f);
+		coarse += adaptive.getCoarseCells();
+
+		const std::list< Vec2<float> >& vertices = *adaptive.getIsolineVertexList();
+		std::vector<float> segments;
+
+		for (std::list< Vec2<float> >::const_iterator it = vertices.begin(); it != vertices.end(); ++it)
+		{
+			segments.push_back(it->x());
+			segments.push_back(it->y());
+		}
+
+		expect(!segments.empty(), "adaptive: the level crosses the view");
+		expect(openEnds(segments, 2.0f, 3.0f, 291.0f, 192.0f) == 0, "adaptive: lines closed at T-junctions");
+	}
+
+	expect(coarse > 0, "adaptive: coarse cells used");
+}
+
+
+// resumable extraction in pieces matches computeIsolines() for every path
+static void checkIsolineCursor()
+{
+	static const int sizes[3][2] = { { 257, 257 }, { 150, 97 }, { 1, 8 } };
+	static const long long budgets[3] = { 1, 100, 5000 };
+
+	for (int s = 0; s < 3; ++s)
+	{
+		const int w = sizes[s][0];
+		const int h = sizes[s][1];
+
+		std::vector<float> heights;
+		makeTerrain(heights, w, h, 0.02f);
+
+		for (int tiling = 0; tiling < 3; ++tiling)
+		{
+			for (int kernel = 0; kernel < 3; ++kernel)
+			{
+				MarchingSquares marchingSquares;
+				marchingSquares.setTiling(static_cast<MarchingSquares::Tiling>(tiling));
+				marchingSquares.setKernel(static_cast<MarchingSquares::Kernel>(kernel));
+				marchingSquares.setHeightMap(w, h, &heights[0]);
+
+				std::vector<float> reference;
+				SegmentBufferSink referenceSink(reference);
+				marchingSquares.computeIsolines(0.55f, referenceSink);
+				expect(reference.empty() == (w < 2), "cursor: the level crosses the view");
+
+				for (int b = 0; b < 3; ++b)
+				{
+					std::vector<float> resumed;
+					SegmentBufferSink sink(resumed);
+					IsolineCursor cursor;
+					cursor.reset(marchingSquares, 0.55f);
+
+					int calls = 0;
+
+					while (!cursor.advance(sink, budgets[b]) && calls < 100000)
+						++calls;
+
+					expect(resumed == reference, "cursor: output equals computeIsolines");
+
+					// ranges past either end are clamped to the steps
+					std::vector<float> clamped;
+					SegmentBufferSink clampedSink(clamped);
+					const long long cells = marchingSquares.computeIsolineSteps(0.55f, -5, marchingSquares.getIsolineSteps() + 7, clampedSink);
+					expect(clamped == reference && cells == cursor.getProcessedCells(), "cursor: step range clamped");
+					expect(marchingSquares.computeIsolineSteps(0.55f, marchingSquares.getIsolineSteps() + 1, marchingSquares.getIsolineSteps() + 9, clampedSink) == 0
+						&& marchingSquares.computeIsolineSteps(0.55f, 3, 2, clampedSink) == 0, "cursor: empty step range");
+					expect(cursor.getProcessedCells() == static_cast<long long>(std::max(w - 1, 0))*std::max(h - 1, 0), "cursor: every cell visited");
+				}
+			}
+		}
+	}
+}
+
+
+// nearest and rectangle queries against a scan of every segment
+static void checkSegmentIndex()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 310, 210, 0.02f);
+	const GridView view = GridView::whole(&heights[0], 310, 210).subView(7, 3, 300, 200);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setGridView(view);
+
+	SegmentIndex index;
+	index.reset(7, 3, 299, 199);
+	std::vector<float> segments;
+	SegmentBufferSink buffer(segments);
+	SinkPair<SegmentBufferSink, SegmentIndex> pair(buffer, index);
+
+	marchingSquares.computeIsolines(0.55f, pair);
+	marchingSquares.computeIsolines(0.6f, pair);
+	index.finalize();
+
+	const int count = static_cast<int>(segments.size()/4);
+	expect(count > 0 && index.size() == count, "index: every segment indexed");
+
+	unsigned int seed = 777u;
+	int nearestMismatches = 0, queryMismatches = 0;
+
+	for (int q = 0; q < 500; ++q)
+	{
+		// probes and rectangles reaching a little outside the view
+		float r[4];
+
+		for (int k = 0; k < 4; ++k)
+		{
+			seed = seed*1664525u + 1013904223u;
+			r[k] = (seed >> 8)/16777216.0f*(k & 1 ? 220.0f : 320.0f) - 10.0f + (k & 1 ? 3.0f : 7.0f);
+		}
+
+		double best = 1e30;
+
+		for (int k = 0; k < count; ++k)
+		{
+			const double x1 = segments[4*k], y1 = segments[4*k+1], x2 = segments[4*k+2], y2 = segments[4*k+3];
+			const double dx = x2 - x1, dy = y2 - y1, length2 = dx*dx + dy*dy;
+			double t = (length2 > 0.0) ? ((r[0] - x1)*dx + (r[1] - y1)*dy)/length2 : 0.0;
+			t = std::min(std::max(t, 0.0), 1.0);
+			best = std::min(best, sqrt((x1 + t*dx - r[0])*(x1 + t*dx - r[0]) + (y1 + t*dy - r[1])*(y1 + t*dy - r[1])));
+		}
+
+		float distance;
+		nearestMismatches += index.nearest(r[0], r[1], distance) < 0 || fabs(distance - best) > 1e-3*std::max(best, 1.0);
+
+		const float xMin = std::min(r[0], r[2]), xMax = std::max(r[0], r[2]);
+		const float yMin = std::min(r[1], r[3]), yMax = std::max(r[1], r[3]);
+		int expected = 0;
+
+		for (int k = 0; k < count; ++k)
+		{
+			// parametric clip against the four sides
+			const double x1 = segments[4*k], y1 = segments[4*k+1];
+			const double p[4] = { x1 - segments[4*k+2], segments[4*k+2] - x1, y1 - segments[4*k+3], segments[4*k+3] - y1 };
+			const double d[4] = { x1 - xMin, xMax - x1, y1 - yMin, yMax - y1 };
+			double t0 = 0.0, t1 = 1.0;
+			bool inside = true;
+
+			for (int e = 0; e < 4 && inside; ++e)
+			{
+				if (p[e] == 0.0)
+					inside = d[e] >= 0.0;
+				else if (p[e] < 0.0)
+					t0 = std::max(t0, d[e]/p[e]);
+				else
+					t1 = std::min(t1, d[e]/p[e]);
+			}
+
+			expected += inside && t0 <= t1;
+		}
+
+		std::vector<int> hits;
+		index.query(xMin, yMin, xMax, yMax, hits);
+		queryMismatches += static_cast<int>(hits.size()) != expected;
+	}
+
+	expect(nearestMismatches == 0, "index: nearest equals the scan");
+	expect(queryMismatches == 0, "index: rectangle query equals the scan");
+}
+
+
+// statistics of fields with known answers, and against the extraction
+static void checkContourStatistics()
+{
+	// ramp h = x: straight vertical lines, exact areas
+	std::vector<float> ramp(65*41);
+
+	for (size_t k = 0; k < ramp.size(); ++k)
+		ramp[k] = static_cast<float>(k % 65);
+
+	static const float rampLevels[3] = { 10.25f, 31.5f, 63.75f };
+	ContourStatistics statistics;
+	statistics.compute(GridView::whole(&ramp[0], 65, 41), std::vector<float>(rampLevels, rampLevels + 3));
+
+	for (int k = 0; k < 3; ++k)
+	{
+		const ContourLevelStatistics& s = statistics.get(k);
+		expect(s.crossingCells == 40 && s.segments == 40 && s.length == 40.0, "statistics: ramp lines");
+		expect(s.area == (64.0 - rampLevels[k])*40.0, "statistics: ramp area");
+	}
+
+	// cone h = -distance: the area above -r is a disc
+	std::vector<float> cone(257*257);
+
+	for (int y = 0; y < 257; ++y)
+		for (int x = 0; x < 257; ++x)
+			cone[y*257 + x] = -sqrtf(float((x - 128)*(x - 128) + (y - 128)*(y - 128)));
+
+	statistics.compute(GridView::whole(&cone[0], 257, 257), -100.0f);
+	const double disc = 3.14159265358979*100.0*100.0;
+	expect(fabs(statistics.get(0).area - disc) <= 5e-5*disc, "statistics: cone area");
+	expect(fabs(statistics.get(0).length - 2.0*3.14159265358979*100.0) <= 1e-4*628.0, "statistics: cone length");
+
+	// saddles and noise: segment counts and lengths as computeIsolines() emits them
+	std::vector<float> heights;
+	makeTerrain(heights, 300, 200, 0.05f);
+
+	// a saddle centred between samples, so the cell around it is ambiguous
+	for (int k = 0; k < 300*60; ++k)
+		heights[k] = 0.55f + 0.01f*((k % 300) - 150.5f)*((k/300) - 30.5f);
+
+	const GridView view = GridView::whole(&heights[0], 300, 200);
+	MarchingSquares marchingSquares;
+	marchingSquares.setGridView(view);
+
+	std::vector<float> levels;
+
+	for (int l = 0; l < 16; ++l)
+		levels.push_back(0.42f + 0.01f*l);
+
+	statistics.setThreads(1);
+	statistics.compute(view, levels);
+	const std::vector<ContourLevelStatistics> single = statistics.getStatistics();
+	long long saddles = 0;
+
+	for (int l = 0; l < 16; ++l)
+	{
+		SegmentCounter counter;
+		marchingSquares.computeIsolines(levels[l], counter);
+		expect(single[l].segments == counter.segments, "statistics: segment count equals the extraction");
+		expect(fabs(single[l].length - counter.length) <= 1e-5*std::max(counter.length, 1.0), "statistics: length equals the extraction");
+		saddles += single[l].segments - single[l].crossingCells;
+	}
+
+	expect(saddles > 0, "statistics: saddle cells covered");
+
+	for (int threads = 2; threads <= 4; threads += 2)
+	{
+		statistics.setThreads(threads);
+		statistics.compute(view, levels);
+
+		bool same = true;
+
+		for (int l = 0; l < 16; ++l)
+			same = same && statistics.get(l).area == single[l].area && statistics.get(l).length == single[l].length
+				&& statistics.get(l).segments == single[l].segments;
+
+		expect(same, "statistics: identical for any thread count");
+	}
+}
+
+
+// supersampling by 1 is the coarse extraction; bilinear lines stay closed
+static void checkSupersampledGrid()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 160, 120, 0.05f);
+	const GridView view = GridView::whole(&heights[0], 160, 120).subView(5, 4, 150, 110);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setGridView(view);
+
+	std::vector<float> coarse;
+	SegmentBufferSink coarseSink(coarse);
+	marchingSquares.computeIsolines(0.55f, coarseSink);
+	expect(!coarse.empty(), "supersample: the level crosses the view");
+
+	SupersampledGrid supersampled;
+	supersampled.setGridView(view);
+	supersampled.setFactor(1);
+
+	for (int m = 0; m < 2; ++m)
+	{
+		supersampled.setInterpolation(static_cast<SupersampledGrid::Interpolation>(m));
+
+		std::vector<float> segments;
+		SegmentBufferSink sink(segments);
+		supersampled.computeIsolines(0.55f, sink);
+		expect(segments == coarse, "supersample: factor 1 equals the coarse extraction");
+	}
+
+	supersampled.setInterpolation(SupersampledGrid::INTERPOLATION_BILINEAR);
+
+	for (int factor = 2; factor <= 8; factor *= 2)
+	{
+		supersampled.setFactor(factor);
+
+		std::vector<float> segments;
+		SegmentBufferSink sink(segments);
+		supersampled.computeIsolines(0.55f, sink);
+
+		expect(segments.size() > coarse.size(), "supersample: sub-cells refined");
+		expect(openEnds(segments, 5.0f, 4.0f, 154.0f, 113.0f) == 0, "supersample: bilinear lines closed");
+	}
+
+	expect(openEnds(coarse, 5.0f, 4.0f, 154.0f, 113.0f) == 0, "supersample: coarse lines closed");
+}
+
+
+// predictions at bin edges are the extraction's exact counts
+static void checkGridAnalysis()
+{
+	std::vector<float> heights;
+	makeTerrain(heights, 200, 150, 0.05f);
+
+	// a saddle between samples, so saddle cells are predicted too
+	for (int k = 0; k < 200*40; ++k)
+		heights[k] = 0.55f + 0.001f*((k % 200) - 100.5f)*((k/200) - 20.5f);
+
+	MarchingSquares marchingSquares;
+	marchingSquares.setHeightMap(200, 150, &heights[0]);
+
+	GridAnalysis analysis;
+	analysis.analyze(marchingSquares.getGridView(), 256);
+
+	int mismatches = 0;
+	long long histogram = 0;
+
+	for (int k = 0; k <= analysis.getBins(); ++k)
+	{
+		SegmentCounter counter;
+		marchingSquares.computeIsolines(analysis.edge(k), counter);
+		mismatches += analysis.segmentsAt(k) != counter.segments || analysis.predictSegments(analysis.edge(k)) != counter.segments;
+		histogram += analysis.getHistogram()[k];
+	}
+
+	expect(mismatches == 0, "analysis: predictions exact at every edge");
+	expect(histogram == analysis.getSampleCount(), "analysis: every sample in the histogram");
+
+	// automatic levels are snapped to edges, so their predictions are exact
+	for (int spacing = 0; spacing < 2; ++spacing)
+	{
+		const std::vector<float> levels = analysis.levels(5, static_cast<GridAnalysis::LevelSpacing>(spacing));
+
+		for (size_t k = 0; k < levels.size(); ++k)
+		{
+			SegmentCounter counter;
+			marchingSquares.computeIsolines(levels[k], counter);
+			expect(counter.segments > 0 && analysis.predictSegments(levels[k]) == counter.segments, "analysis: level prediction exact");
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// labels the regions above (4-connected) or below (8-connected) the level by
+// flood fill, -1 outside; returns their number
+static int floodComponents(const std::vector<float>& values, const int width, const int height,
+						   const ContourTree::Side side, const float level, std::vector<int>& labels)
+{
+	static const int dx[8] = { -1, 1,  0, 0, -1,  1, -1, 1 };
+	static const int dy[8] = {  0, 0, -1, 1, -1, -1,  1, 1 };
+	const int neighbours = (side == ContourTree::ABOVE) ? 4 : 8;
+
+	labels.assign(values.size(), -1);
+	int count = 0;
+	std::vector<int> stack;
+
+	for (int v = 0; v < static_cast<int>(values.size()); ++v)
+	{
+		const bool inside = (side == ContourTree::ABOVE) ? (values[v] > level) : (values[v] <= level);
+
+		if (!inside || labels[v] >= 0)
+			continue;
+
+		labels[v] = count;
+		stack.assign(1, v);
+
+		while (!stack.empty())
+		{
+			const int w = stack.back();
+			stack.pop_back();
+
+			for (int k = 0; k < neighbours; ++k)
+			{
+				const int nx = w % width + dx[k];
+				const int ny = w/width + dy[k];
+
+				if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+					continue;
+
+				const int n = ny*width + nx;
+				const float value = values[n];
+
+				if (labels[n] < 0 && ((side == ContourTree::ABOVE) ? (value > level) : (value <= level)))
+				{
+					labels[n] = count;
+					stack.push_back(n);
+				}
+			}
+		}
+
+		++count;
+	}
+
+	return count;
+}
+
+
+//
+static void checkContourTree()
+{
+	static const int sizes[3][2] = { { 7, 5 }, { 12, 9 }, { 16, 16 } };
+	unsigned int seed = 777u;
+	int countMismatches = 0;
+	int seedMismatches = 0;
+	int nestingMismatches = 0;
+	int levelsChecked = 0;
+
+	for (int trial = 0; trial < 30; ++trial)
+	{
+		const int width = sizes[trial % 3][0];
+		const int height = sizes[trial % 3][1];
+
+		// few distinct values, so plateaus, ties and saddles are common
+		std::vector<float> values(width*height);
+
+		for (size_t k = 0; k < values.size(); ++k)
+		{
+			seed = seed*1664525u + 1013904223u;
+			values[k] = static_cast<float>((seed >> 16) % 6);
+		}
+
+		ContourTree tree;
+		tree.build(GridView::whole(&values[0], width, height));
+
+		for (int side = 0; side < 2; ++side)
+		{
+			const ContourTree::Side s = static_cast<ContourTree::Side>(side);
+
+			for (int step = -1; step <= 11; ++step)
+			{
+				const float level = 0.5f*step;
+				std::vector<int> labels;
+				const int count = floodComponents(values, width, height, s, level, labels);
+
+				std::vector<ContourTree::Component> components;
+				tree.components(s, level, components);
+
+				countMismatches += tree.componentCount(s, level) != count || static_cast<int>(components.size()) != count;
+				++levelsChecked;
+
+				// one seed in each flood-filled region
+				std::vector<int> seen(count, 0);
+
+				for (size_t c = 0; c < components.size(); ++c)
+				{
+					const int label = labels[components[c].seed];
+					seedMismatches += label < 0 || seen[label]++ > 0;
+				}
+
+				// nesting: the region containing a component further along the
+				// sweep is the one its seed falls in there
+				const float further = (s == ContourTree::ABOVE) ? level - 1.0f : level + 1.0f;
+				std::vector<int> furtherLabels;
+				floodComponents(values, width, height, s, further, furtherLabels);
+
+				std::vector<ContourTree::Component> furtherComponents;
+				tree.components(s, further, furtherComponents);
+
+				for (size_t c = 0; c < components.size(); ++c)
+				{
+					const int arc = tree.containingArc(s, components[c].arc, further);
+					int expected = -1;
+
+					for (size_t f = 0; f < furtherComponents.size(); ++f)
+					{
+						if (furtherLabels[furtherComponents[f].seed] == furtherLabels[components[c].seed])
+							expected = furtherComponents[f].arc;
+					}
+
+					nestingMismatches += arc < 0 || arc != expected;
+				}
+			}
+		}
+	}
+
+	expect(levelsChecked > 0 && countMismatches == 0, "contour tree: component counts match flood fill");
+	expect(seedMismatches == 0, "contour tree: one seed per flood-filled component");
+	expect(nestingMismatches == 0, "contour tree: nesting matches flood fill");
+}
+
+
+//
+static int runChecks()
+{
+	checkDegenerateViews();
+	checkReliefNonFinite();
+	checkShardedBandRows();
+	checkExportNumbers();
+	checkCursorValidation();
+	checkCacheSpill();
+	checkChunkedHeightMap();
+	checkIsolineCursor();
+	checkAdaptiveExact();
+	checkAdaptiveStitched();
+	checkTileIndex();
+	checkSetData();
+	checkSegmentIndex();
+	checkContourStatistics();
+	checkSupersampledGrid();
+	checkGridAnalysis();
+	checkContourTree();
+
+	printf("%s\n", checkFailures ? "checks failed" : "all checks passed");
+	return checkFailures ? 1 : 0;
+}
+
+
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: benchmark tiling|adaptive|export|sink|kernel|index|cache|levels|sharded|fixed|spatial|relief|spill|stats|supersample [width] [height] | check\n");
+		return 1;
+	}
+
+	if (strcmp(argv[1], "check") == 0)
+		return runChecks();
+
+	const int width = (argc > 2) ? atoi(argv[2]) : 16384;
+	const int height = (argc > 3) ? atoi(argv[3]) : 2048;
+
+	if (strcmp(argv[1], "tiling") == 0)
+		benchTiling(width, height);
+	else if (strcmp(argv[1], "adaptive") == 0)
+		benchAdaptive(width, height);
+	else if (strcmp(argv[1], "export") == 0)
+		benchExport(width, height);
+	else if (strcmp(argv[1], "sink") == 0)
+		benchSink(width, height);
+	else if (strcmp(argv[1], "kernel") == 0)
+		benchKernel(width, height);
+	else if (strcmp(argv[1], "index") == 0)
+		benchIndex(width, height);
+	else if (strcmp(argv[1], "cache") == 0)
+		benchCache(width, height);
+	else if (strcmp(argv[1], "levels") == 0)
+		benchLevels(width, height);
+	else if (strcmp(argv[1], "sharded") == 0)
+		benchSharded(width, height);
+	else if (strcmp(argv[1], "fixed") == 0)
+		benchFixed(width, height);
+	else if (strcmp(argv[1], "spatial") == 0)
+		benchSpatial(width, height);
+	else if (strcmp(argv[1], "relief") == 0)
+		benchRelief(width, height);
+	else if (strcmp(argv[1], "spill") == 0)
+		benchSpill(width, height);
+	else if (strcmp(argv[1], "stats") == 0)
+		benchStats(width, height);
+	else if (strcmp(argv[1], "supersample") == 0)
+		benchSupersample(width, height);
+	else
+	{
+		fprintf(stderr, "unknown benchmark %s\n", argv[1]);
+		return 1;
+	}
+
+	return 0;
+}
@@ -5,6 +5,13 @@
 #include <iostream>
 
 #include "MarchingSquares.h"
+#include "ChunkedHeightMap.h"
+#include "IsolineCursor.h"
+#include "GridAnalysis.h"
+#include "SegmentIndex.h"
+#include "ReliefRaster.h"
+#include <cstdlib>
+#include <cstring>
 
 //-----------------------------------------------------------------------------
 
@@ -14,6 +21,21 @@ int imageLenght = 0;
 
 MarchingSquares marchingSquares;
 
+// isolines are filled in progressively from idle(), FRAME_BUDGET seconds per call
+IsolineCursor isolineCursor;
+const double FRAME_BUDGET = 0.008;
+
+// segments by bucket, for picking the contour under the mouse
+SegmentIndex segmentIndex;
+int pickedSegment = -1;
+int windowWidth = 500;
+int windowHeight = 500;
+
+// hillshaded heights, drawn as one texture
+ReliefRaster relief;
+GLuint heightsTexture = 0;
+unsigned int heightsGeneration = 0;
+
 
 //-----------------------------------------------------------------------------
 void drawAxis()
@@ -35,21 +57,40 @@ void drawAxis()
 //-----------------------------------------------------------------------------
 void drawHeights()
 {
-	if (marchingSquares.getData() != NULL)
-	{
-		glBegin(GL_POINTS);
-		for (int i = 0 ; i < marchingSquares.getHeight(); ++i)
-		{
-			for (int j = 0; j < marchingSquares.getHeight(); ++j) 
-			{
-				const float& color = marchingSquares.atDataIndex(i,j);
+	if (relief.getPixels() == NULL)
+		return;
 
-				glColor3f(color, color, color);
-				glVertex2f(i,j);
-			}
-		}
-		glEnd();
+	// the image is rendered once by relief.update(); upload it only when it changed
+	if (heightsTexture == 0)
+		glGenTextures(1, &heightsTexture);
+
+	glBindTexture(GL_TEXTURE_2D, heightsTexture);
+
+	if (heightsGeneration != relief.getGeneration())
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, relief.getWidth(), relief.getHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE, relief.getPixels());
+		heightsGeneration = relief.getGeneration();
 	}
+
+	// texel centres on the sample positions
+	const GridView& view = marchingSquares.getGridView();
+	const float x0 = view.originX - 0.5f;
+	const float y0 = view.originY - 0.5f;
+	const float x1 = x0 + relief.getWidth();
+	const float y1 = y0 + relief.getHeight();
+
+	glEnable(GL_TEXTURE_2D);
+	glColor3f(1.0f, 1.0f, 1.0f);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0.0f, 0.0f); glVertex2f(x0, y0);
+	glTexCoord2f(1.0f, 0.0f); glVertex2f(x1, y0);
+	glTexCoord2f(1.0f, 1.0f); glVertex2f(x1, y1);
+	glTexCoord2f(0.0f, 1.0f); glVertex2f(x0, y1);
+	glEnd();
+	glDisable(GL_TEXTURE_2D);
 }
 
 
@@ -108,19 +149,62 @@ void display()
 	glColor3f(marchingSquares.getThreshold(), 0.0f, 1.0f- marchingSquares.getThreshold());
 	drawIsolines();
 
+	if (pickedSegment >= 0)
+	{
+		const SegmentIndex::Segment& s = segmentIndex.getSegment(pickedSegment);
+
+		glColor3f(1.0f, 1.0f, 0.0f);
+		glBegin(GL_LINES);
+		glVertex2f(s.x1, s.y1);
+		glVertex2f(s.x2, s.y2);
+		glEnd();
+	}
+
 	glutSwapBuffers();
 }
 
 
 void idle()
 {
-	
+	if (isolineCursor.done())
+		return;
+
+	VertexListSink vertices(*marchingSquares.getIsolineVertexList());
+	SinkPair<VertexListSink, SegmentIndex> sink(vertices, segmentIndex);
+
+	if (isolineCursor.advance(sink, 0, FRAME_BUDGET))
+		segmentIndex.finalize();
+
+	glutPostRedisplay();
+}
+
+
+//-----------------------------------------------------------------------------
+void mouse(int button, int state, int x, int y)
+{
+	if (button != GLUT_LEFT_BUTTON || state != GLUT_DOWN || !isolineCursor.done())
+		return;
+
+	// window to map coordinates, see myReshape()
+	const float mapX = x*float(imageWidth)/windowWidth;
+	const float mapY = (windowHeight - y)*float(imageLenght)/windowHeight;
+
+	float distance;
+	pickedSegment = segmentIndex.nearest(mapX, mapY, distance);
+
+	if (pickedSegment >= 0)
+		std::cout << "nearest isoline at " << distance << " pixels" << std::endl;
+
+	glutPostRedisplay();
 }
 
 
 //-----------------------------------------------------------------------------
 void myReshape(int w, int h)
 {
+	windowWidth = (w > 0) ? w : 1;
+	windowHeight = (h > 0) ? h : 1;
+
     glViewport(0, 0, w, h);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -184,9 +268,36 @@ void loadImage(char* filename)
 }
 
 
+//-----------------------------------------------------------------------------
+// -convert image.tga output.msh [chunkSize]
+bool convertImage(int argc, char **argv)
+{
+	loadImage(argv[2]);
+
+	if (heights_ == NULL)
+		return false;
+
+	const int chunkSize = (argc > 4) ? atoi(argv[4]) : 256;
+
+	if (!ChunkedHeightMap::write(argv[3], GridView::whole(heights_, imageWidth, imageLenght), chunkSize))
+	{
+		std::cerr << "Nao gravou " << argv[3] << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------
 void main(int argc, char **argv)
 {
+	if (argc > 3 && strcmp(argv[1], "-convert") == 0)
+	{
+		convertImage(argc, argv);
+		return;
+	}
+
     glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
 	glutInitWindowSize(500, 500);
@@ -197,12 +308,36 @@ void main(int argc, char **argv)
 	glutReshapeFunc(myReshape);
     glutDisplayFunc(display); 
 	glutIdleFunc(idle);
+	glutMouseFunc(mouse);
   
 	loadImage("hm3.png");
 	//loadImage("hm4.tga");
 
 	marchingSquares.setHeightMap(imageWidth, imageLenght, heights_);
-	marchingSquares.computeIsolines(0.63f);
+
+	relief.setZFactor(0.25f*imageWidth);
+	relief.update(marchingSquares.getGridView());
+
+	marchingSquares.setProfiling(argc > 1 && strcmp(argv[1], "-profile") == 0);
+
+	// median level of the image instead of a fixed threshold
+	GridAnalysis analysis;
+	analysis.analyze(marchingSquares.getGridView());
+
+	const float threshold = analysis.levels(1, GridAnalysis::LEVELS_QUANTILE)[0];
+	std::cout << "threshold " << threshold << ", " << analysis.predictSegments(threshold) << " segments" << std::endl;
+
+	if (marchingSquares.isProfiling())
+	{
+		marchingSquares.computeIsolines(threshold);
+		marchingSquares.getProfile().report(stdout);
+	}
+	else
+	{
+		marchingSquares.setThreshold(threshold);
+		isolineCursor.reset(marchingSquares, threshold);
+		segmentIndex.reset(0, 0, imageWidth - 1, imageLenght - 1);
+	}
 	//marchingSquares.setThreshold(0.4f);
 	//marchingSquares.debugInfo();
 